@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <psAnisotropicProcess.hpp>
+
+inline double getTime() {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return std::chrono::duration<double>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Compares the per point evaluation of the anisotropic velocity field, as
+// done during advection, with the batched evaluation over arrays of normals.
+int main(int argc, char *argv[]) {
+  using NumericType = double;
+  constexpr int D = 3;
+  using velocityFieldType =
+      AnisotropicProcessImplementation::VelocityField<NumericType, D>;
+
+  // The number of surface points
+  unsigned N = 1'000'000;
+  if (argc > 1) {
+    int tmp = std::atoi(argv[1]);
+    if (tmp > 0)
+      N = static_cast<unsigned>(tmp);
+  }
+
+  // The number repetitions
+  unsigned repetitions = 10;
+  if (argc > 2) {
+    int tmp = std::atoi(argv[2]);
+    if (tmp > 0)
+      repetitions = static_cast<unsigned>(tmp);
+  }
+
+  // Same setup as the wet etching of the cantilever example
+  const std::vector<std::pair<psMaterial, NumericType>> materials = {
+      {psMaterial::Si, -1.}};
+  velocityFieldType velocityField(
+      {0.707106781187, 0.707106781187, 0.},
+      {-0.707106781187, 0.707106781187, 0.}, 797. / 60., 1210. / 60.,
+      4.3 / 60., 1150. / 60., materials);
+
+  std::cout << "Generating normals...\n";
+  std::mt19937_64 engine(42);
+  std::normal_distribution<NumericType> normal(0., 1.);
+  std::uniform_int_distribution<int> material(0, 9);
+  std::vector<std::array<NumericType, 3>> normals(N);
+  std::vector<int> materialIds(N);
+  for (unsigned i = 0; i < N; ++i) {
+    std::array<NumericType, 3> nv{normal(engine), normal(engine),
+                                  normal(engine)};
+    const auto norm = std::sqrt(nv[0] * nv[0] + nv[1] * nv[1] + nv[2] * nv[2]);
+    for (auto &n : nv)
+      n /= norm;
+    normals[i] = nv;
+    // most of the surface is silicon, the rest is mask
+    materialIds[i] = material(engine) == 0 ? 0 : 1;
+  }
+
+  const std::array<NumericType, 3> origin{0., 0., 0.};
+  std::vector<NumericType> pointVelocities(N);
+  auto startTime = getTime();
+  for (unsigned r = 0; r < repetitions; ++r) {
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < static_cast<long>(N); ++i)
+      pointVelocities[i] = velocityField.getScalarVelocity(
+          origin, materialIds[i], normals[i], static_cast<unsigned long>(i));
+  }
+  auto endTime = getTime();
+  std::cout << N << " per point evaluations completed in "
+            << (endTime - startTime) / repetitions << "s\n";
+
+  std::vector<NumericType> batchVelocities;
+  startTime = getTime();
+  for (unsigned r = 0; r < repetitions; ++r)
+    velocityField.getScalarVelocities(normals, materialIds, batchVelocities);
+  endTime = getTime();
+  std::cout << N << " batched evaluations completed in "
+            << (endTime - startTime) / repetitions << "s\n";
+
+  NumericType maxDifference = 0.;
+  for (unsigned i = 0; i < N; ++i)
+    maxDifference = std::max(
+        maxDifference, std::abs(pointVelocities[i] - batchVelocities[i]));
+  std::cout << "Maximum difference: " << maxDifference << "\n";
+
+  if (maxDifference > 1e-10) {
+    std::cout << "Velocities differ!\n";
+    return 1;
+  }
+}
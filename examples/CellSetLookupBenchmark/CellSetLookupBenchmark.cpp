@@ -0,0 +1,133 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <csBVH.hpp>
+#include <geometries/psMakeFin.hpp>
+#include <psDomain.hpp>
+
+inline double getTime() {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return std::chrono::duration<double>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Compares the cell lookup of csDenseCellSet, which uses a dense lattice of
+// cell ids, with the lookup through the octree (csBVH) used before, and times
+// the octree build.
+int main(int argc, char *argv[]) {
+  using NumericType = double;
+  constexpr int D = 3;
+
+  // The number of lookups
+  unsigned N = 1'000'000;
+  if (argc > 1) {
+    int tmp = std::atoi(argv[1]);
+    if (tmp > 0)
+      N = static_cast<unsigned>(tmp);
+  }
+
+  // The grid spacing
+  NumericType gridDelta = 0.2;
+  if (argc > 2) {
+    NumericType tmp = std::atof(argv[2]);
+    if (tmp > 0.)
+      gridDelta = tmp;
+  }
+
+  std::cout << "Generating cell set...\n";
+  auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+  psMakeFin<NumericType, D>(domain, gridDelta, 10., 10., 2.5, 5., 0., false,
+                            false)
+      .apply();
+  domain->generateCellSet(-5., false);
+  auto cellSet = domain->getCellSet();
+  std::cout << cellSet->getNumberOfCells() << " cells\n";
+
+  // Octree built the same way as previously in csDenseCellSet
+  const auto bounds = cellSet->getBoundingBox();
+  auto minExtent = bounds[1][0] - bounds[0][0];
+  for (unsigned i = 1; i < D; ++i)
+    minExtent = std::min(minExtent, bounds[1][i] - bounds[0][i]);
+  unsigned layers = 0;
+  while (minExtent / 2 > gridDelta) {
+    layers++;
+    minExtent /= 2;
+  }
+  csBVH<NumericType, D> bvh(bounds, layers);
+  const auto &nodes = cellSet->getNodes();
+  const auto elems = cellSet->getElements();
+
+  // The octree build is timed with a single thread and with all threads. The
+  // build also reports its time through the logger.
+  psLogger::setLogLevel(psLogLevel::TIMING);
+#ifdef _OPENMP
+  const int maxThreads = omp_get_max_threads();
+  omp_set_num_threads(1);
+#endif
+  auto startTime = getTime();
+  bvh.build(nodes, elems);
+  auto endTime = getTime();
+  std::cout << "Octree built with 1 thread in " << endTime - startTime
+            << "s\n";
+#ifdef _OPENMP
+  omp_set_num_threads(maxThreads);
+  startTime = getTime();
+  bvh.build(nodes, elems);
+  endTime = getTime();
+  std::cout << "Octree built with " << maxThreads << " threads in "
+            << endTime - startTime << "s\n";
+#endif
+  auto bvhFindIndex = [&](const std::array<NumericType, 3> &point) {
+    for (const auto cellId : bvh.getCellIds(point)) {
+      const auto &cellMin = nodes[elems[cellId][0]];
+      bool isInside = true;
+      for (unsigned i = 0; i < D; ++i)
+        isInside = isInside && point[i] >= cellMin[i] &&
+                   point[i] <= cellMin[i] + gridDelta;
+      if (isInside)
+        return static_cast<int>(cellId);
+    }
+    return -1;
+  };
+
+  // Random points in the bounding box of the cell set
+  std::mt19937_64 engine(42);
+  std::vector<std::array<NumericType, 3>> points(N);
+  for (auto &point : points) {
+    for (unsigned i = 0; i < D; ++i)
+      point[i] = std::uniform_real_distribution<NumericType>(
+          bounds[0][i], bounds[1][i])(engine);
+  }
+
+  std::vector<int> bvhIds(N);
+  startTime = getTime();
+  for (unsigned i = 0; i < N; ++i)
+    bvhIds[i] = bvhFindIndex(points[i]);
+  endTime = getTime();
+  std::cout << N << " octree lookups completed in " << endTime - startTime
+            << "s\n";
+
+  std::vector<int> latticeIds(N);
+  startTime = getTime();
+  for (unsigned i = 0; i < N; ++i)
+    latticeIds[i] = cellSet->getIndex(points[i]);
+  endTime = getTime();
+  std::cout << N << " lattice lookups completed in " << endTime - startTime
+            << "s\n";
+
+  // Points on the face between two cells may be assigned to either cell
+  unsigned numDifferent = 0;
+  for (unsigned i = 0; i < N; ++i)
+    numDifferent += bvhIds[i] != latticeIds[i];
+  std::cout << numDifferent << " lookups differ\n";
+}
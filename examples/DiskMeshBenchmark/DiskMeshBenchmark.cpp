@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include <iostream>
+
+#include <geometries/psMakeHole.hpp>
+#include <psProcess.hpp>
+#include <psSingleParticleProcess.hpp>
+#include <psUtils.hpp>
+
+#include <lsToDiskMesh.hpp>
+
+using NumericType = double;
+constexpr int D = 3;
+
+// Measures the time spent in disk mesh conversions during a hole deposition.
+// Before the post-advection disk mesh was reused, every time step performed
+// one additional conversion, whose cost is estimated by converting the final
+// geometry again.
+int main(int argc, char *argv[]) {
+  psLogger::setLogLevel(psLogLevel::WARNING);
+
+  // The grid spacing
+  NumericType gridDelta = 0.05;
+  if (argc > 1) {
+    NumericType tmp = std::atof(argv[1]);
+    if (tmp > 0.)
+      gridDelta = tmp;
+  }
+
+  auto geometry = psSmartPointer<psDomain<NumericType, D>>::New();
+  psMakeHole<NumericType, D>(geometry, gridDelta, 3., 3., 0.75, 2.).apply();
+  geometry->duplicateTopLevelSet();
+
+  auto model = psSmartPointer<psSingleParticleProcess<NumericType, D>>::New(
+      1. /*deposition rate*/, 0.1 /*sticking probability*/);
+  psProcess<NumericType, D> process(geometry, model, 0.5);
+  process.setNumberOfRaysPerPoint(100);
+  process.apply();
+
+  const auto &profile = process.getProfile();
+  double conversionTime = 0.;
+  for (const auto &step : profile.steps)
+    conversionTime += step.diskMeshConversion;
+
+  // time of a single conversion of all level sets
+  const unsigned numRepetitions = 10;
+  psUtils::Timer timer;
+  for (unsigned i = 0; i < numRepetitions; ++i) {
+    auto mesh = psSmartPointer<lsMesh<NumericType>>::New();
+    lsToDiskMesh<NumericType, D> meshConverter(mesh);
+    for (auto levelSet : *geometry->getLevelSets())
+      meshConverter.insertNextLevelSet(levelSet);
+    timer.start();
+    meshConverter.apply();
+    timer.finish();
+  }
+  const double singleConversion = timer.totalDuration * 1e-9 / numRepetitions;
+  const double savedTime = singleConversion * profile.steps.size();
+
+  std::cout << "Time steps: " << profile.steps.size() << "\n"
+            << "Process time [s]: " << profile.total << "\n"
+            << "Disk mesh conversions [s]: " << conversionTime << "\n"
+            << "Single conversion [s]: " << singleConversion << "\n"
+            << "Saved conversions [s]: " << savedTime << " ("
+            << 100. * savedTime / (profile.total + savedTime)
+            << " % of the process time without reuse)\n";
+}
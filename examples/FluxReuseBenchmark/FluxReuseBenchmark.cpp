@@ -0,0 +1,84 @@
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <geometries/psMakeTrench.hpp>
+#include <psKDTree.hpp>
+#include <psProcess.hpp>
+#include <psSingleParticleProcess.hpp>
+#include <psToDiskMesh.hpp>
+
+using NumericType = double;
+constexpr int D = 2;
+
+psSmartPointer<psDomain<NumericType, D>> makeGeometry() {
+  auto geometry = psSmartPointer<psDomain<NumericType, D>>::New();
+  psMakeTrench<NumericType, D>(geometry, 0.02 /*grid delta*/,
+                               1. /*x extent*/, 1. /*y extent*/,
+                               0.4 /*trench width*/, 0.8 /*trench depth*/)
+      .apply();
+  geometry->duplicateTopLevelSet();
+  return geometry;
+}
+
+std::vector<std::array<NumericType, 3>>
+getSurfacePoints(psSmartPointer<psDomain<NumericType, D>> geometry) {
+  auto mesh = psSmartPointer<lsMesh<NumericType>>::New();
+  psToDiskMesh<NumericType, D>(geometry, mesh).apply();
+  return mesh->getNodes();
+}
+
+// Runs the deposition and returns the run time in seconds.
+double runProcess(psSmartPointer<psDomain<NumericType, D>> geometry,
+                  unsigned maxSteps, NumericType maxDisplacement) {
+  auto model = psSmartPointer<psSingleParticleProcess<NumericType, D>>::New(
+      1. /*deposition rate*/, 0.1 /*sticking probability*/,
+      1. /*source power*/);
+
+  psProcess<NumericType, D> process(geometry, model, 5.);
+  process.setNumberOfRaysPerPoint(1000);
+  process.setFluxUpdateInterval(maxSteps, maxDisplacement);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  process.apply();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+// Compares the deposition with fluxes calculated in every advection step to
+// the deposition with fluxes reused over several steps. The accuracy is
+// measured as the distance of the final surface to the reference surface.
+int main() {
+  psLogger::setLogLevel(psLogLevel::WARNING);
+
+  auto reference = makeGeometry();
+  const double referenceTime = runProcess(reference, 1, 0.);
+  auto referencePoints = getSurfacePoints(reference);
+  psKDTree<NumericType, std::array<NumericType, 3>> tree(referencePoints);
+  tree.build();
+
+  std::cout << "Flux update interval, max. displacement, time [s], "
+               "mean deviation, max. deviation\n";
+  std::cout << "1, 0, " << referenceTime << ", 0, 0\n";
+
+  const std::vector<std::pair<unsigned, NumericType>> settings = {
+      {2, 0.}, {4, 0.}, {8, 0.}, {8, 1.}, {16, 2.}};
+  for (const auto &[maxSteps, maxDisplacement] : settings) {
+    auto geometry = makeGeometry();
+    const double time = runProcess(geometry, maxSteps, maxDisplacement);
+
+    NumericType meanDeviation = 0., maxDeviation = 0.;
+    auto points = getSurfacePoints(geometry);
+    for (const auto &point : points) {
+      const NumericType distance = tree.findNearest(point)->second;
+      meanDeviation += distance;
+      maxDeviation = std::max(maxDeviation, distance);
+    }
+    meanDeviation /= points.size();
+
+    std::cout << maxSteps << ", " << maxDisplacement << ", " << time << ", "
+              << meanDeviation << ", " << maxDeviation << "\n";
+  }
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <psTranslationField.hpp>
+
+inline double getTime() {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return std::chrono::duration<double>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Compares the lookup of surface point ids through the hash map generated by
+// lsToDiskMesh with the lookup through the dense translator used in psProcess.
+int main(int argc, char *argv[]) {
+  using NumericType = double;
+  using translationField = psTranslationField<NumericType>;
+
+  // The number of level set points
+  unsigned N = 1'000'000;
+  if (argc > 1) {
+    int tmp = std::atoi(argv[1]);
+    if (tmp > 0)
+      N = static_cast<unsigned>(tmp);
+  }
+
+  // The number repetitions
+  unsigned repetitions = 10;
+  if (argc > 2) {
+    int tmp = std::atoi(argv[2]);
+    if (tmp > 0)
+      repetitions = static_cast<unsigned>(tmp);
+  }
+
+  // Roughly a third of the level set points lie on the surface
+  std::cout << "Generating translator...\n";
+  std::mt19937_64 engine(42);
+  std::vector<unsigned long> lsIds(N);
+  std::iota(lsIds.begin(), lsIds.end(), 0ul);
+  std::shuffle(lsIds.begin(), lsIds.end(), engine);
+  translationField::translatorType translator;
+  for (unsigned i = 0; i < N / 3; ++i)
+    translator[lsIds[i]] = i;
+
+  // The advection queries every level set point in order
+  std::vector<unsigned long> queries(N);
+  std::iota(queries.begin(), queries.end(), 0ul);
+
+  translationField::denseTranslatorType denseTranslator;
+  auto startTime = getTime();
+  for (unsigned r = 0; r < repetitions; ++r)
+    translationField::toDenseTranslator(translator, N, denseTranslator);
+  auto endTime = getTime();
+  std::cout << "Dense translator built in "
+            << (endTime - startTime) / repetitions << "s\n";
+
+  unsigned long checksum = 0;
+  startTime = getTime();
+  for (unsigned r = 0; r < repetitions; ++r) {
+    for (const auto id : queries) {
+      if (auto it = translator.find(id); it != translator.end())
+        checksum += it->second;
+    }
+  }
+  endTime = getTime();
+  std::cout << N << " hash map lookups completed in "
+            << (endTime - startTime) / repetitions << "s\n";
+
+  unsigned long denseChecksum = 0;
+  startTime = getTime();
+  for (unsigned r = 0; r < repetitions; ++r) {
+    for (const auto id : queries) {
+      if (denseTranslator[id] != translationField::unmappedId)
+        denseChecksum += denseTranslator[id];
+    }
+  }
+  endTime = getTime();
+  std::cout << N << " dense lookups completed in "
+            << (endTime - startTime) / repetitions << "s\n";
+
+  if (checksum != denseChecksum) {
+    std::cout << "Lookup results differ!\n";
+    return 1;
+  }
+}
@@ -1,24 +1,58 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
 #include <csBoundingVolume.hpp>
 
 #include <lsSmartPointer.hpp>
 
+#include <psLogger.hpp>
+#include <psUtils.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /// Helper class to quickly determine the cell in which a given point resides
-/// in. To do so, an octree is built around the cell set structure.
+/// in. To do so, an octree is built around the cell set structure. The cells
+/// of all leaves are stored in one flat array (CSR layout), sorted by leaf.
+/// csDenseCellSet looks up cells through a dense lattice of cell ids instead.
+/// The octree remains as an alternative for sparse cell sets, where the
+/// lattice would mostly hold empty entries, and as the baseline of the
+/// CellSetLookupBenchmark example.
 template <class T, int D> class csBVH {
 private:
   using BVPtrType = lsSmartPointer<csBoundingVolume<T, D>>;
   using BoundsType = csPair<std::array<T, D>>;
-  using CellIdsPtr = std::set<unsigned> *;
 
   unsigned numLayers = 1;
   BVPtrType BV = nullptr;
+  std::size_t numLeafKeys = 0;
+
+  // cells of leaf key k: cellIds[leafOffsets[k]] to cellIds[leafOffsets[k+1]]
+  std::vector<unsigned> leafOffsets;
+  std::vector<unsigned> cellIds;
 
 public:
+  // Ids of the cells in one leaf of the octree, in ascending order.
+  struct CellIdRange {
+    const unsigned *first = nullptr;
+    const unsigned *last = nullptr;
+
+    const unsigned *begin() const { return first; }
+    const unsigned *end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+  };
+
   csBVH(const BoundsType &domainBounds, unsigned layers = 1)
       : numLayers(layers) {
-    BV = BVPtrType::New(domainBounds, numLayers - 1);
+    BV = BVPtrType::New(domainBounds, int(numLayers) - 1);
+    numLeafKeys = BV->getNumberOfLeafKeys();
+    leafOffsets.assign(numLeafKeys + 1, 0);
   }
 
   BVPtrType getTopBV() { return BV; }
@@ -27,11 +61,135 @@ public:
     BV->getBoundingVolumeBounds(point);
   }
 
-  CellIdsPtr getCellIds(const std::array<T, 3> &point) {
-    return BV->getCellIds(point);
+  // Returns the cells in the leaf containing the point. The range is empty if
+  // the point is outside of the octree.
+  CellIdRange getCellIds(const std::array<T, 3> &point) const {
+    const auto key = BV->getLeafKey(point);
+    if (key >= numLeafKeys)
+      return {};
+    return {cellIds.data() + leafOffsets[key],
+            cellIds.data() + leafOffsets[key + 1]};
   }
 
-  void clearCellIds() { BV->clear(); }
+  // Sort the cells into the leaves containing their nodes. The leaf keys of
+  // all nodes are computed in parallel and then sorted with a stable parallel
+  // radix sort, so the cells of each leaf end up in ascending order without
+  // any locking.
+  void build(const std::vector<std::array<T, 3>> &nodes,
+             const std::vector<std::array<unsigned, (1 << D)>> &elems) {
+    psUtils::Timer timer;
+    timer.start();
+
+    constexpr unsigned nodesPerCell = 1 << D;
+    const long numEntries = elems.size() * nodesPerCell;
+    std::vector<std::uint64_t> keys(numEntries);
+    bool isOutside = false;
+#pragma omp parallel for schedule(static)
+    for (long n = 0; n < numEntries; ++n) {
+      const auto &node = nodes[elems[n / nodesPerCell][n % nodesPerCell]];
+      const auto key = BV->getLeafKey(node);
+      if (key >= numLeafKeys) {
+#pragma omp atomic write
+        isOutside = true;
+      }
+      keys[n] = key < numLeafKeys ? key : numLeafKeys;
+    }
+    if (isOutside)
+      psLogger::getInstance().addError("BVH building error.").print();
+
+    std::vector<long> order(numEntries);
+    sortByKey(keys, order);
+
+    // count the distinct cells of each leaf; entries of one cell in a leaf
+    // are adjacent after the stable sort
+    cellIds.clear();
+    cellIds.reserve(numEntries);
+    leafOffsets.assign(numLeafKeys + 1, 0);
+    for (long i = 0; i < numEntries; ++i) {
+      const auto key = keys[order[i]];
+      if (key == numLeafKeys)
+        break;
+      const unsigned cellId = order[i] / nodesPerCell;
+      if (i > 0 && keys[order[i - 1]] == key && cellIds.back() == cellId)
+        continue;
+      cellIds.push_back(cellId);
+      ++leafOffsets[key + 1];
+    }
+    for (std::size_t k = 0; k < numLeafKeys; ++k)
+      leafOffsets[k + 1] += leafOffsets[k];
+
+    timer.finish();
+    psLogger::getInstance()
+        .addTiming("Building cell set BVH took", timer.currentDuration * 1e-9)
+        .print();
+  }
 
-  size_t getTotalCellCount() { return BV->getTotalCellCounts(); }
-};
\ No newline at end of file
+  void clearCellIds() {
+    cellIds.clear();
+    leafOffsets.assign(numLeafKeys + 1, 0);
+  }
+
+  size_t getTotalCellCount() { return cellIds.size(); }
+
+private:
+  // Stable LSD radix sort of the entry indices by key, 8 bits per pass. Each
+  // thread counts and scatters a contiguous block of entries.
+  void sortByKey(const std::vector<std::uint64_t> &keys,
+                 std::vector<long> &order) const {
+    constexpr unsigned radixBits = 8;
+    constexpr unsigned numBuckets = 1 << radixBits;
+    const long numEntries = keys.size();
+    // keys range from 0 to numLeafKeys (cells outside of the octree)
+    unsigned numPasses = 0;
+    while (numPasses * radixBits < 64 &&
+           (std::uint64_t(numLeafKeys) >> (numPasses * radixBits)) != 0)
+      ++numPasses;
+
+    for (long i = 0; i < numEntries; ++i)
+      order[i] = i;
+    std::vector<long> buffer(numEntries);
+
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    std::vector<std::array<long, numBuckets>> counts(numThreads);
+
+    for (unsigned pass = 0; pass < numPasses; ++pass) {
+      const unsigned shift = pass * radixBits;
+#pragma omp parallel num_threads(numThreads)
+      {
+        int thread = 0, threads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        threads = omp_get_num_threads();
+#endif
+        const long first = numEntries * thread / threads;
+        const long last = numEntries * (thread + 1) / threads;
+        auto &count = counts[thread];
+        count.fill(0);
+        for (long i = first; i < last; ++i)
+          ++count[(keys[order[i]] >> shift) & (numBuckets - 1)];
+
+#pragma omp barrier
+#pragma omp single
+        {
+          // offsets ordered by bucket, then by thread, keep the sort stable
+          long offset = 0;
+          for (unsigned b = 0; b < numBuckets; ++b) {
+            for (int t = 0; t < threads; ++t) {
+              const long c = counts[t][b];
+              counts[t][b] = offset;
+              offset += c;
+            }
+          }
+        }
+
+        for (long i = first; i < last; ++i)
+          buffer[count[(keys[order[i]] >> shift) & (numBuckets - 1)]++] =
+              order[i];
+      }
+      order.swap(buffer);
+    }
+  }
+};
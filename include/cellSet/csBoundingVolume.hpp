@@ -1,206 +1,135 @@
 #pragma once
 
-#include <set>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <vector>
 
 #include <csUtil.hpp>
 
-#include <lsSmartPointer.hpp>
-
+/// Octree of bounding volumes, stored as one flat array of nodes. Every node
+/// is split into 2^D child volumes at its center; the children of node i are
+/// the nodes i * 2^D + 1 to i * 2^D + 2^D, so no links have to be stored. A
+/// child volume contains a point if the point lies in the half-open interval
+/// (lower, upper] in every direction. The child volumes of the lowest layer
+/// are the leaves, which are identified by a key.
 template <class T, int D> class csBoundingVolume {
 private:
-  using BVPtrType = lsSmartPointer<csBoundingVolume<T, D>>;
   using BoundsType = csPair<std::array<T, D>>;
-  using CellIdsPtr = std::set<unsigned> *;
 
   static constexpr int numCells = 1 << D;
-  std::array<std::set<unsigned>, numCells> cellIds;
-  std::array<BoundsType, numCells> bounds;
-  std::array<BVPtrType, numCells> links;
-  int layer = -1;
-
-public:
-  csBoundingVolume() {}
-  csBoundingVolume(const BoundsType &outerBound, int thisLayer)
-      : layer(thisLayer) {
 
-    if constexpr (D == 3)
-      buildBounds3D(outerBound);
-    else
-      buildBounds2D(outerBound);
+  // The node spans [lower, upper], its children are split at center.
+  struct Node {
+    std::array<T, D> lower;
+    std::array<T, D> center;
+    std::array<T, D> upper;
+  };
 
-    if (layer > 0) {
-      for (size_t i = 0; i < numCells; i++) {
-        links[i] = BVPtrType::New(bounds[i], layer - 1);
-      }
-    }
-  }
+  std::vector<Node> nodes;
+  std::size_t firstLeafNode = 0;
 
-  CellIdsPtr getCellIds(const std::array<T, 3> &point) {
-    auto vid = getVolumeIndex(point);
-    // assert(vid < numCells && "Point in invalid BV");
+public:
+  static constexpr std::size_t invalidKey =
+      std::numeric_limits<std::size_t>::max();
 
-    if (vid == numCells)
-      return nullptr;
+  csBoundingVolume() {}
 
-    if (layer == 0) {
-      return &cellIds[vid];
+  // Build the octree with the given number of layers below the top volume.
+  csBoundingVolume(const BoundsType &outerBound, int topLayer) {
+    std::size_t numNodes = 1;
+    std::size_t layerNodes = 1;
+    for (int layer = topLayer; layer > 0; --layer) {
+      firstLeafNode += layerNodes;
+      layerNodes *= numCells;
+      numNodes += layerNodes;
     }
 
-    return links[vid]->getCellIds(point);
-  }
-
-  void getBoundingVolumeBounds(const std::array<T, D> &point) {
-    auto vid = getVolumeIndex(point);
-    assert(vid < numCells && "Point in invalid BV");
-
-    if (layer == 0) {
-      printBound(vid);
-      return;
+    nodes.resize(numNodes);
+    nodes[0] = makeNode(outerBound[0], outerBound[1]);
+    for (std::size_t i = 0; i < firstLeafNode; ++i) {
+      for (int c = 0; c < numCells; ++c) {
+        const auto bounds = getChildBounds(i, c);
+        nodes[i * numCells + 1 + c] = makeNode(bounds[0], bounds[1]);
+      }
     }
-
-    links[vid]->getBoundingVolumeBounds(point);
   }
 
-  size_t getTotalCellCounts() {
-    size_t count = 0;
-    if (layer == 0) {
-      for (size_t i = 0; i < numCells; i++) {
-        count += cellIds[i].size();
-      }
-      return count;
-    } else {
-      for (size_t i = 0; i < numCells; i++) {
-        count += links[i]->getTotalCellCounts();
-      }
-    }
-    return count;
+  // Number of keys used for the leaves.
+  std::size_t getNumberOfLeafKeys() const {
+    return (nodes.size() - firstLeafNode) * numCells;
   }
 
-  void clear() {
-    if (layer == 0) {
-      for (size_t i = 0; i < numCells; i++) {
-        cellIds[i].clear();
-      }
-    } else {
-      for (size_t i = 0; i < numCells; i++) {
-        links[i]->clear();
-      }
+  // Key of the leaf volume containing the point. The leaf volumes are
+  // numbered from 0 to getNumberOfLeafKeys() - 1. Returns invalidKey if the
+  // point is outside.
+  std::size_t getLeafKey(const std::array<T, 3> &point) const {
+    std::size_t nodeIdx = 0;
+    while (true) {
+      auto vid = getVolumeIndex(nodeIdx, point);
+      if (vid == numCells)
+        return invalidKey;
+      if (nodeIdx >= firstLeafNode)
+        return (nodeIdx - firstLeafNode) * numCells + vid;
+      nodeIdx = nodeIdx * numCells + 1 + vid;
     }
   }
 
-  BVPtrType getLink(const std::array<T, 3> &point) {
-    auto vid = getVolumeIndex(point);
-    return getLink(vid);
+  void getBoundingVolumeBounds(const std::array<T, 3> &point) const {
+    auto key = getLeafKey(point);
+    assert(key != invalidKey && "Point in invalid BV");
+    printBound(firstLeafNode + key / numCells, key % numCells);
   }
 
-  BVPtrType getLink(size_t vid) { return links[vid]; }
-
-  size_t getVolumeIndex(const std::array<T, 3> &point) {
-    size_t vid = numCells;
-    for (size_t idx = 0; idx < numCells; idx++) {
-      if (insideVolume(point, idx)) {
-        vid = idx;
-        break;
+  // Index of the child volume of the node which contains the point, or 2^D if
+  // the point is outside of the node.
+  size_t getVolumeIndex(const std::size_t nodeIdx,
+                        const std::array<T, 3> &p) const {
+    const auto &node = nodes[nodeIdx];
+    size_t vid = 0;
+    for (int i = 0; i < D; ++i) {
+      if (p[i] > node.center[i] && p[i] <= node.upper[i]) {
+        vid |= 1 << i;
+      } else if (!(p[i] > node.lower[i] && p[i] <= node.center[i])) {
+        return numCells;
       }
     }
     return vid;
   }
 
-  bool insideVolume(const std::array<T, 3> &p, const size_t idx) const {
-    if constexpr (D == 3) {
-      return p[0] > bounds[idx][0][0] && p[0] <= bounds[idx][1][0] &&
-             p[1] > bounds[idx][0][1] && p[1] <= bounds[idx][1][1] &&
-             p[2] > bounds[idx][0][2] && p[2] <= bounds[idx][1][2];
-    } else {
-      return p[0] > bounds[idx][0][0] && p[0] <= bounds[idx][1][0] &&
-             p[1] > bounds[idx][0][1] && p[1] <= bounds[idx][1][1];
-    }
-  }
-
-  void printBound(size_t vid) {
+  void printBound(const std::size_t nodeIdx, const size_t vid) const {
+    const auto bounds = getChildBounds(nodeIdx, vid);
     std::cout << "Bounding volume span: [";
     for (int i = 0; i < D; i++)
-      std::cout << bounds[vid][0][i] << ", ";
+      std::cout << bounds[0][i] << ", ";
     std::cout << "] - [";
     for (int i = 0; i < D; i++)
-      std::cout << bounds[vid][1][i] << ", ";
+      std::cout << bounds[1][i] << ", ";
     std::cout << "]\n";
   }
 
 private:
-  void buildBounds2D(const BoundsType &outerBound) {
-    auto xExt = (outerBound[1][0] - outerBound[0][0]) / 2.;
-    auto yExt = (outerBound[1][1] - outerBound[0][1]) / 2.;
-
-    const auto BVH1 =
-        csPair<csPair<T>>{outerBound[0][0], outerBound[0][1],
-                          outerBound[0][0] + xExt, outerBound[0][1] + yExt};
-    const auto BVH2 =
-        csPair<csPair<T>>{outerBound[0][0] + xExt, outerBound[0][1],
-                          outerBound[0][0] + 2 * xExt, outerBound[0][1] + yExt};
-    const auto BVH3 = csPair<csPair<T>>{
-        outerBound[0][0] + xExt,
-        outerBound[0][1] + yExt,
-        outerBound[0][0] + 2 * xExt,
-        outerBound[0][1] + 2 * yExt,
-    };
-    const auto BVH4 = csPair<csPair<T>>{
-        outerBound[0][0],
-        outerBound[0][1] + yExt,
-        outerBound[0][0] + xExt,
-        outerBound[0][1] + 2 * yExt,
-    };
-
-    bounds =
-        std::array<csPair<std::array<T, D>>, numCells>{BVH1, BVH2, BVH3, BVH4};
+  static Node makeNode(const std::array<T, D> &lower,
+                       const std::array<T, D> &upper) {
+    Node node;
+    for (int i = 0; i < D; ++i) {
+      const T extent = (upper[i] - lower[i]) / T(2);
+      node.lower[i] = lower[i];
+      node.center[i] = lower[i] + extent;
+      node.upper[i] = lower[i] + 2 * extent;
+    }
+    return node;
   }
 
-  void buildBounds3D(const BoundsType &outerBound) {
-    auto xExt = (outerBound[1][0] - outerBound[0][0]) / T(2);
-    auto yExt = (outerBound[1][1] - outerBound[0][1]) / T(2);
-    auto zExt = (outerBound[1][2] - outerBound[0][2]) / T(2);
-
-    const auto BVH1 =
-        csPair<csTriple<T>>{outerBound[0][0],        outerBound[0][1],
-                            outerBound[0][2],        outerBound[0][0] + xExt,
-                            outerBound[0][1] + yExt, outerBound[0][2] + zExt};
-    const auto BVH2 = csPair<csTriple<T>>{
-        outerBound[0][0] + xExt, outerBound[0][1],
-        outerBound[0][2],        outerBound[0][0] + 2 * xExt,
-        outerBound[0][1] + yExt, outerBound[0][2] + zExt};
-    const auto BVH3 = csPair<csTriple<T>>{outerBound[0][0] + xExt,
-                                          outerBound[0][1] + yExt,
-                                          outerBound[0][2],
-                                          outerBound[0][0] + 2 * xExt,
-                                          outerBound[0][1] + 2 * yExt,
-                                          outerBound[0][2] + zExt};
-    const auto BVH4 = csPair<csTriple<T>>{outerBound[0][0],
-                                          outerBound[0][1] + yExt,
-                                          outerBound[0][2],
-                                          outerBound[0][0] + xExt,
-                                          outerBound[0][1] + 2 * yExt,
-                                          outerBound[0][2] + zExt};
-
-    // top
-    const auto BVH5 = csPair<csTriple<T>>{
-        outerBound[0][0],        outerBound[0][1],
-        outerBound[0][2] + zExt, outerBound[0][0] + xExt,
-        outerBound[0][1] + yExt, outerBound[0][2] + 2 * zExt};
-    const auto BVH6 = csPair<csTriple<T>>{
-        outerBound[0][0] + xExt, outerBound[0][1],
-        outerBound[0][2] + zExt, outerBound[0][0] + 2 * xExt,
-        outerBound[0][1] + yExt, outerBound[0][2] + 2 * zExt};
-    const auto BVH7 = csPair<csTriple<T>>{
-        outerBound[0][0] + xExt,     outerBound[0][1] + yExt,
-        outerBound[0][2] + zExt,     outerBound[0][0] + 2 * xExt,
-        outerBound[0][1] + 2 * yExt, outerBound[0][2] + 2 * zExt};
-    const auto BVH8 = csPair<csTriple<T>>{outerBound[0][0],
-                                          outerBound[0][1] + yExt,
-                                          outerBound[0][2] + zExt,
-                                          outerBound[0][0] + xExt,
-                                          outerBound[0][1] + 2 * yExt,
-                                          outerBound[0][2] + 2 * zExt};
-    bounds = std::array<csPair<std::array<T, D>>, numCells>{
-        BVH1, BVH2, BVH3, BVH4, BVH5, BVH6, BVH7, BVH8};
+  BoundsType getChildBounds(const std::size_t nodeIdx, const size_t vid) const {
+    const auto &node = nodes[nodeIdx];
+    BoundsType bounds;
+    for (int i = 0; i < D; ++i) {
+      const bool upperHalf = vid & (1 << i);
+      bounds[0][i] = upperHalf ? node.center[i] : node.lower[i];
+      bounds[1][i] = upperHalf ? node.upper[i] : node.center[i];
+    }
+    return bounds;
   }
 };
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+/// Sparse lattice storing the cell id at integer grid indices. The lattice is
+/// split into bricks of 8^D sites, which are only allocated once a cell is
+/// inserted into them, so the memory scales with the number of occupied
+/// bricks instead of the bounding box of the cells. Empty sites are -1.
+template <int D> class csCellLattice {
+private:
+  static constexpr int brickBits = 3;
+  static constexpr int brickMask = (1 << brickBits) - 1;
+  static constexpr int sitesPerBrick = 1 << (brickBits * D);
+
+  std::array<int, D> minIndex{};
+  std::array<int, D> maxIndex{};
+  std::array<int, D> numBricks{};
+  // allocated brick of each brick position, -1 if not allocated
+  std::vector<int> brickIds;
+  std::vector<int> sites;
+
+public:
+  csCellLattice() { clear(); }
+
+  // Remove all cells and set the range of grid indices covered by the
+  // lattice. Both bounds are inclusive.
+  void initialize(const std::array<int, D> &passedMinIndex,
+                  const std::array<int, D> &passedMaxIndex) {
+    minIndex = passedMinIndex;
+    maxIndex = passedMaxIndex;
+    std::size_t numBrickPositions = 1;
+    for (int i = 0; i < D; ++i) {
+      numBricks[i] = ((maxIndex[i] - minIndex[i]) >> brickBits) + 1;
+      numBrickPositions *= numBricks[i];
+    }
+    brickIds.assign(numBrickPositions, -1);
+    sites.clear();
+  }
+
+  void clear() {
+    minIndex.fill(0);
+    maxIndex.fill(-1);
+    numBricks.fill(0);
+    brickIds.clear();
+    sites.clear();
+  }
+
+  // Insert the cell at the grid indices, allocating its brick if needed. An
+  // existing cell at the same indices is kept. Returns false if the indices
+  // are outside of the lattice.
+  bool insert(const std::array<int, D> &indices, const int cellId) {
+    if (!isInside(indices))
+      return false;
+    auto &brickId = brickIds[getBrickPosition(indices)];
+    if (brickId < 0) {
+      brickId = static_cast<int>(sites.size() / sitesPerBrick);
+      sites.resize(sites.size() + sitesPerBrick, -1);
+    }
+    auto &site = sites[std::size_t(brickId) * sitesPerBrick +
+                       getSiteInBrick(indices)];
+    if (site < 0)
+      site = cellId;
+    return true;
+  }
+
+  // Returns the cell id at the grid indices, or -1 if there is no cell.
+  int find(const std::array<int, D> &indices) const {
+    if (!isInside(indices))
+      return -1;
+    const int brickId = brickIds[getBrickPosition(indices)];
+    if (brickId < 0)
+      return -1;
+    return sites[std::size_t(brickId) * sitesPerBrick +
+                 getSiteInBrick(indices)];
+  }
+
+  bool isInside(const std::array<int, D> &indices) const {
+    for (int i = 0; i < D; ++i)
+      if (indices[i] < minIndex[i] || indices[i] > maxIndex[i])
+        return false;
+    return true;
+  }
+
+  bool empty() const { return sites.empty(); }
+
+  const std::array<int, D> &getMinIndex() const { return minIndex; }
+
+  const std::array<int, D> &getMaxIndex() const { return maxIndex; }
+
+  std::size_t getNumberOfBricks() const { return sites.size() / sitesPerBrick; }
+
+  // Memory used by the brick index and the allocated bricks in bytes.
+  std::size_t getMemoryUsage() const {
+    return (brickIds.capacity() + sites.capacity()) * sizeof(int);
+  }
+
+private:
+  std::size_t getBrickPosition(const std::array<int, D> &indices) const {
+    std::size_t position = (indices[D - 1] - minIndex[D - 1]) >> brickBits;
+    for (int i = D - 2; i >= 0; --i)
+      position =
+          position * numBricks[i] + ((indices[i] - minIndex[i]) >> brickBits);
+    return position;
+  }
+
+  int getSiteInBrick(const std::array<int, D> &indices) const {
+    int site = 0;
+    for (int i = 0; i < D; ++i)
+      site |= ((indices[i] - minIndex[i]) & brickMask) << (brickBits * i);
+    return site;
+  }
+};
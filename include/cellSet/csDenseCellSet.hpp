@@ -1,11 +1,18 @@
 #ifndef DENSE_CELL_SET
 #define DENSE_CELL_SET
 
-#include <csBVH.hpp>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <csCellLattice.hpp>
 #include <csTracePath.hpp>
 #include <csUtil.hpp>
 
 #include <lsDomain.hpp>
+#include <lsExpand.hpp>
 #include <lsMakeGeometry.hpp>
 #include <lsMesh.hpp>
 #include <lsToSurfaceMesh.hpp>
@@ -16,11 +23,14 @@
 #include <psLogger.hpp>
 #include <psMaterials.hpp>
 #include <psSmartPointer.hpp>
+#include <psUtils.hpp>
 #include <psVTKWriter.hpp>
 
 /**
   This class represents a cell-based voxel implementation of a volume. The
-  depth of the cell set in z-direction can be specified.
+  depth of the cell set in z-direction can be specified. In the structured grid
+  mode, the cells are not stored as a hexahedral mesh; only the grid indices of
+  each cell are kept and the coordinates are computed from them.
 */
 template <class T, int D> class csDenseCellSet {
 private:
@@ -32,18 +42,23 @@ private:
   levelSetsType levelSets = nullptr;
   gridType cellGrid = nullptr;
   psSmartPointer<lsDomain<T, D>> surface = nullptr;
-  psSmartPointer<csBVH<T, D>> BVH = nullptr;
   materialMapType materialMap = nullptr;
   std::vector<std::array<int, 2 * D>> cellNeighbors; // -x, x, -y, y, -z, z
   T gridDelta;
   size_t numberOfCells;
   T depth = 0.;
-  int BVHlayers = 0;
   bool cellSetAboveSurface = false;
+  bool structuredGrid = false;
+  T surfaceBandWidth = 0.;
   std::bitset<D> periodicBoundary;
   std::vector<T> *fillingFractions;
   const T eps = 1e-4;
   hrleVectorType<hrleIndexType, D> minIndex, maxIndex;
+  // Cell ids indexed by the grid indices of the minimum corner of the cell.
+  csCellLattice<D> cellLattice;
+  // Grid indices of the minimum corner of each cell, only used in the
+  // structured grid mode. The cell grid then only holds the cell data.
+  std::vector<std::array<int, D>> cellIndices;
 
 public:
   csDenseCellSet() {}
@@ -60,6 +75,7 @@ public:
                      T passedDepth = 0.) {
     levelSets = passedLevelSets;
     materialMap = passedMaterialMap;
+    cellNeighbors.clear();
 
     if (cellGrid == nullptr)
       cellGrid = psSmartPointer<lsMesh<T>>::New();
@@ -72,28 +88,28 @@ public:
     gridDelta = surface->getGrid().getGridDelta();
 
     depth = passedDepth;
-    std::vector<psSmartPointer<lsDomain<T, D>>> levelSetsInOrder;
-    auto plane = psSmartPointer<lsDomain<T, D>>::New(surface->getGrid());
-    {
-      T origin[D] = {0.};
-      T normal[D] = {0.};
-      origin[D - 1] = depth;
-      normal[D - 1] = 1.;
-      lsMakeGeometry<T, D>(plane,
-                           psSmartPointer<lsPlane<T, D>>::New(origin, normal))
-          .apply();
-    }
-    if (!cellSetAboveSurface)
-      levelSetsInOrder.push_back(plane);
-    for (auto ls : *levelSets)
-      levelSetsInOrder.push_back(ls);
-    if (cellSetAboveSurface) {
-      levelSetsInOrder.push_back(plane);
+    auto levelSetsInOrder = getLevelSetsInOrder();
+
+    if (surfaceBandWidth > 0. && !structuredGrid) {
+      psLogger::getInstance()
+          .addWarning("Cell set surface band requires the structured grid "
+                      "mode. Using structured grid.")
+          .print();
+      structuredGrid = true;
     }
 
     calculateMinMaxIndex(levelSetsInOrder);
-    lsToVoxelMesh<T, D>(levelSetsInOrder, cellGrid).apply();
-    // lsToVoxelMesh also saves the extent in the cell grid
+    if (structuredGrid) {
+      createStructuredCells(levelSetsInOrder);
+    } else {
+      cellIndices.clear();
+      lsToVoxelMesh<T, D>(levelSetsInOrder, cellGrid).apply();
+      // lsToVoxelMesh also saves the extent in the cell grid
+      for (unsigned i = 0; i < D; ++i) {
+        cellGrid->minimumExtent[i] -= eps;
+        cellGrid->maximumExtent[i] += eps;
+      }
+    }
 
 #ifndef NDEBUG
     int db_ls = 0;
@@ -103,40 +119,23 @@ public:
       psVTKWriter<T>(mesh, "cellSet_debug_" + std::to_string(db_ls++) + ".vtp")
           .apply();
     }
-    psVTKWriter<T>(cellGrid, "cellSet_debug_init.vtu").apply();
+    writeVTU("cellSet_debug_init.vtu");
 #endif
 
     if (!cellSetAboveSurface || materialMap)
       adjustMaterialIds();
 
     // create filling fractions as default scalar cell data
-    numberOfCells = cellGrid->template getElements<(1 << D)>().size();
+    numberOfCells = structuredGrid
+                        ? cellIndices.size()
+                        : cellGrid->template getElements<(1 << D)>().size();
     std::vector<T> fillingFractionsTemp(numberOfCells, 0.);
 
     cellGrid->getCellData().insertNextScalarData(
         std::move(fillingFractionsTemp), "fillingFraction");
     fillingFractions = cellGrid->getCellData().getScalarData("fillingFraction");
 
-    // calculate number of BVH layers
-    for (unsigned i = 0; i < D; ++i) {
-      cellGrid->minimumExtent[i] -= eps;
-      cellGrid->maximumExtent[i] += eps;
-    }
-    auto minExtent = cellGrid->maximumExtent[0] - cellGrid->minimumExtent[0];
-    minExtent = std::min(minExtent, cellGrid->maximumExtent[1] -
-                                        cellGrid->minimumExtent[1]);
-    if constexpr (D == 3)
-      minExtent = std::min(minExtent, cellGrid->maximumExtent[2] -
-                                          cellGrid->minimumExtent[2]);
-
-    BVHlayers = 0;
-    while (minExtent / 2 > gridDelta) {
-      BVHlayers++;
-      minExtent /= 2;
-    }
-
-    BVH = psSmartPointer<csBVH<T, D>>::New(getBoundingBox(), BVHlayers);
-    buildBVH();
+    buildCellLattice();
   }
 
   csPair<std::array<T, D>> getBoundingBox() const {
@@ -149,6 +148,25 @@ public:
           cellGrid->maximumExtent[0], cellGrid->maximumExtent[1]};
   }
 
+  // Set whether the cells should be stored on a structured grid instead of a
+  // hexahedral mesh. Takes effect when the cell set is created.
+  void setStructuredGrid(const bool passedStructuredGrid) {
+    structuredGrid = passedStructuredGrid;
+  }
+
+  bool getStructuredGrid() const { return structuredGrid; }
+
+  // Only create cells within the given distance of the surface, so that the
+  // memory of the cell set scales with the surface area instead of the
+  // volume. Cells which come within this distance when the surface moves are
+  // added in updateSurface. A width of 0 creates all cells down to the depth.
+  // Requires the structured grid mode.
+  void setSurfaceBandWidth(const T passedSurfaceBandWidth) {
+    surfaceBandWidth = passedSurfaceBandWidth;
+  }
+
+  T getSurfaceBandWidth() const { return surfaceBandWidth; }
+
   void setPeriodicBoundary(std::array<bool, D> isPeriodic) {
     for (int i = 0; i < D; i++) {
       periodicBoundary[i] = isPeriodic[i];
@@ -166,6 +184,8 @@ public:
 
   T getGridDelta() const { return gridDelta; }
 
+  // The nodes and elements are empty in the structured grid mode, use
+  // getCellCenter instead.
   std::vector<std::array<T, 3>> &getNodes() const {
     return cellGrid->getNodes();
   }
@@ -174,10 +194,31 @@ public:
     return cellGrid->template getElements<(1 << D)>();
   }
 
+  // Returns the center of the cell with the given index.
+  csTriple<T> getCellCenter(const unsigned long idx) const {
+    auto center = getCellMin(idx);
+    for (int i = 0; i < D; ++i)
+      center[i] += gridDelta / 2.;
+    return center;
+  }
+
   psSmartPointer<lsDomain<T, D>> getSurface() { return surface; }
 
+  // Returns the mesh holding the cell data. In the structured grid mode, the
+  // mesh does not contain any nodes or elements.
   psSmartPointer<lsMesh<T>> getCellGrid() { return cellGrid; }
 
+  // Returns a copy of the cell grid including the cell data. In the
+  // structured grid mode, the nodes and elements are generated.
+  psSmartPointer<lsMesh<T>> getCellMesh() const {
+    auto mesh = psSmartPointer<lsMesh<T>>::New(*cellGrid);
+    if (!structuredGrid)
+      return mesh;
+
+    generateCells(cellIndices, *mesh);
+    return mesh;
+  }
+
   levelSetsType getLevelSets() const { return levelSets; }
 
   size_t getNumberOfCells() const { return numberOfCells; }
@@ -200,11 +241,7 @@ public:
     T sum = 0.;
     int count = 0;
     for (int i = 0; i < numberOfCells; i++) {
-      auto &cell = cellGrid->template getElements<(1 << D)>()[i];
-      auto node = cellGrid->getNodes()[cell[0]];
-      for (int j = 0; j < D; j++)
-        node[j] += gridDelta / 2.;
-      if (csUtil::distance(node, point) < radius) {
+      if (csUtil::distance(getCellCenter(i), point) < radius) {
         sum += fillingFractions->at(i);
         count++;
       }
@@ -269,7 +306,7 @@ public:
 
   // Write the cell set as .vtu file
   void writeVTU(std::string fileName) {
-    psVTKWriter<T>(cellGrid, fileName).apply();
+    psVTKWriter<T>(structuredGrid ? getCellMesh() : cellGrid, fileName).apply();
   }
 
   // Save cell set data in simple text format
@@ -349,6 +386,102 @@ public:
     file.close();
   }
 
+  // Write the cell set to a binary stream. Besides the cell data, the
+  // settings of the cell set and the grid indices of all cells are written,
+  // so that the cells can be restored even if the surface has changed since.
+  void serialize(std::ostream &stream) const {
+    psUtils::writeBinary(stream, depth);
+    psUtils::writeBinary(stream, static_cast<char>(cellSetAboveSurface));
+    psUtils::writeBinary(stream, static_cast<char>(structuredGrid));
+    psUtils::writeBinary(stream, surfaceBandWidth);
+    psUtils::writeBinary(
+        stream, static_cast<std::uint64_t>(periodicBoundary.to_ulong()));
+
+    std::vector<std::array<int, D>> indices(numberOfCells);
+    for (std::size_t i = 0; i < numberOfCells; i++)
+      indices[i] = getCellIndices(i);
+    psUtils::writeBinary(stream, indices);
+
+    auto &cellData = cellGrid->getCellData();
+    psUtils::writeBinary(
+        stream, static_cast<std::uint64_t>(cellData.getScalarDataSize()));
+    for (std::size_t i = 0; i < cellData.getScalarDataSize(); i++) {
+      psUtils::writeBinary(stream, cellData.getScalarDataLabel(i));
+      psUtils::writeBinary(stream, *cellData.getScalarData(i));
+    }
+  }
+
+  // Read a cell set written by serialize. The cells are restored from the
+  // stored grid indices and the surface is taken from the passed level sets.
+  // Returns false and leaves the cell set unchanged if the data is invalid.
+  bool deserialize(std::istream &stream, levelSetsType passedLevelSets,
+                   materialMapType passedMaterialMap = nullptr) {
+    T readDepth = 0., readSurfaceBandWidth = 0.;
+    char readAboveSurface = 0, readStructuredGrid = 0;
+    std::uint64_t readPeriodicBoundary = 0, numScalarData = 0;
+    std::vector<std::array<int, D>> indices;
+    psUtils::readBinary(stream, readDepth);
+    psUtils::readBinary(stream, readAboveSurface);
+    psUtils::readBinary(stream, readStructuredGrid);
+    psUtils::readBinary(stream, readSurfaceBandWidth);
+    psUtils::readBinary(stream, readPeriodicBoundary);
+    psUtils::readBinary(stream, indices);
+    psUtils::readBinary(stream, numScalarData);
+
+    std::vector<std::string> labels(numScalarData);
+    std::vector<std::vector<T>> data(numScalarData);
+    bool compatible = true;
+    for (std::uint64_t i = 0; i < numScalarData && stream; i++) {
+      psUtils::readBinary(stream, labels[i]);
+      psUtils::readBinary(stream, data[i]);
+      compatible = compatible && data[i].size() == indices.size();
+    }
+
+    if (!compatible || !stream || passedLevelSets == nullptr ||
+        passedLevelSets->empty()) {
+      psLogger::getInstance().addWarning("Incompatible cell set data.").print();
+      return false;
+    }
+
+    levelSets = passedLevelSets;
+    materialMap = passedMaterialMap;
+    depth = readDepth;
+    cellSetAboveSurface = readAboveSurface;
+    structuredGrid = readStructuredGrid;
+    surfaceBandWidth = readSurfaceBandWidth;
+    periodicBoundary = std::bitset<D>(readPeriodicBoundary);
+    cellNeighbors.clear();
+
+    if (surface == nullptr)
+      surface = psSmartPointer<lsDomain<T, D>>::New(levelSets->back());
+    else
+      surface->deepCopy(levelSets->back());
+    gridDelta = surface->getGrid().getGridDelta();
+    calculateMinMaxIndex(getLevelSetsInOrder());
+
+    if (cellGrid == nullptr)
+      cellGrid = psSmartPointer<lsMesh<T>>::New();
+    cellGrid->clear();
+    numberOfCells = indices.size();
+    if (structuredGrid) {
+      cellIndices = std::move(indices);
+    } else {
+      cellIndices.clear();
+      generateCells(indices, *cellGrid);
+    }
+    calculateCellExtent();
+
+    for (std::uint64_t i = 0; i < numScalarData; i++)
+      cellGrid->getCellData().insertNextScalarData(std::move(data[i]),
+                                                   labels[i]);
+    fillingFractions = getScalarData("fillingFraction");
+    if (fillingFractions == nullptr)
+      addScalarData("fillingFraction", 0.);
+
+    buildCellLattice();
+    return true;
+  }
+
   // Clear the filling fractions
   void clear() {
     auto ff = getFillingFractions();
@@ -362,131 +495,84 @@ public:
   void updateMaterials() {
     auto materialIds = getScalarData("Material");
 
-    // create overlay material
-    std::vector<psSmartPointer<lsDomain<T, D>>> levelSetsInOrder;
-    auto plane = psSmartPointer<lsDomain<T, D>>::New(surface->getGrid());
-    {
-      T origin[D] = {0.};
-      T normal[D] = {0.};
-      origin[D - 1] = depth;
-      normal[D - 1] = 1.;
-      lsMakeGeometry<T, D>(plane,
-                           psSmartPointer<lsPlane<T, D>>::New(origin, normal))
-          .apply();
-    }
-    if (!cellSetAboveSurface)
-      levelSetsInOrder.push_back(plane);
-    for (auto ls : *levelSets)
-      levelSetsInOrder.push_back(ls);
-    if (cellSetAboveSurface)
-      levelSetsInOrder.push_back(plane);
-
-    // set up iterators for all materials
-    std::vector<hrleConstDenseCellIterator<typename lsDomain<T, D>::DomainType>>
-        iterators;
-    for (auto it = levelSetsInOrder.begin(); it != levelSetsInOrder.end();
-         ++it) {
-      iterators.push_back(
-          hrleConstDenseCellIterator<typename lsDomain<T, D>::DomainType>(
-              (*it)->getDomain(), minIndex));
-    }
-
-    // move iterator for lowest material id and then adjust others if they are
-    // needed
+    // the cells are found on the lattice, so the material of a cell does not
+    // depend on the order in which the voxels are visited
     const materialMapType matMapPtr = materialMap;
-    unsigned cellIdx = 0;
-    for (; iterators.front().getIndices() < maxIndex;
-         iterators.front().next()) {
-      // go over all materials
-      for (unsigned materialId = 0; materialId < levelSetsInOrder.size();
-           ++materialId) {
-
-        auto &cellIt = iterators[materialId];
-        cellIt.goToIndicesSequential(iterators.front().getIndices());
-
-        // find out whether the centre of the box is inside
-        T centerValue = 0.;
-        for (int i = 0; i < (1 << D); ++i) {
-          centerValue += cellIt.getCorner(i).getValue();
-        }
-
-        if (centerValue <= 0.) {
-          bool isVoxel;
-          // check if voxel is in bounds
-          for (unsigned i = 0; i < (1 << D); ++i) {
-            hrleVectorType<hrleIndexType, D> index;
-            isVoxel = true;
-            for (unsigned j = 0; j < D; ++j) {
-              index[j] =
-                  cellIt.getIndices(j) + cellIt.getCorner(i).getOffset()[j];
-              if (index[j] > maxIndex[j]) {
-                isVoxel = false;
-                break;
-              }
-            }
-          }
-
-          if (isVoxel) {
-            if (matMapPtr) {
-              auto material = matMapPtr->getMaterialAtIdx(materialId);
-              materialIds->at(cellIdx++) = static_cast<int>(material);
-            } else {
-              materialIds->at(cellIdx++) = materialId;
-            }
-          }
-
-          // jump out of material for loop
-          break;
-        }
-      }
-    }
-    assert(cellIdx == numberOfCells &&
-           "Cell set changed in `updateMaterials()'");
+    visitVoxels(getLevelSetsInOrder(),
+                [&](const std::array<int, D> &indices, unsigned materialId) {
+                  const int cellIdx = getCellAt(indices);
+                  if (cellIdx < 0)
+                    return;
+                  if (matMapPtr) {
+                    auto material = matMapPtr->getMaterialAtIdx(materialId);
+                    materialIds->at(cellIdx) = static_cast<int>(material);
+                  } else {
+                    materialIds->at(cellIdx) = materialId;
+                  }
+                });
   }
 
   // Updates the surface of the cell set. The new surface should be below the
   // old surface as this function can only remove cells from the cell set.
+  // With a surface band, the cells which come within the band of the new
+  // surface are added. The neighborhood is updated if it was built.
   void updateSurface() {
-    auto updateCellGrid = psSmartPointer<lsMesh<T>>::New();
-
-    lsToVoxelMesh<T, D> voxelConverter(updateCellGrid);
-    {
-      auto plane = psSmartPointer<lsDomain<T, D>>::New(surface->getGrid());
-      T origin[D] = {0.};
-      T normal[D] = {0.};
-      origin[D - 1] = depth;
-      normal[D - 1] = 1.;
-
-      lsMakeGeometry<T, D>(plane,
-                           psSmartPointer<lsPlane<T, D>>::New(origin, normal))
-          .apply();
-      voxelConverter.insertNextLevelSet(plane);
-    }
-    voxelConverter.insertNextLevelSet(levelSets->back());
-    voxelConverter.insertNextLevelSet(surface);
-    voxelConverter.apply();
-
-    auto cutMatIds = updateCellGrid->getCellData().getScalarData("Material");
-    auto &hexas = cellGrid->template getElements<(1 << D)>();
-
-    const auto nCutCells =
-        updateCellGrid->template getElements<(1 << D)>().size();
-
-    auto numScalarData = cellGrid->getCellData().getScalarDataSize();
-
-    for (int elIdx = nCutCells - 1; elIdx >= 0; elIdx--) {
-      if (cutMatIds->at(elIdx) == 2) {
-        for (int i = 0; i < numScalarData; i++) {
-          auto data = cellGrid->getCellData().getScalarData(i);
-          data->erase(data->begin() + elIdx);
-        }
-        hexas.erase(hexas.begin() + elIdx);
+    std::vector<char> removeCell(numberOfCells, 0);
+    std::size_t numNewCells = 0;
+    if (structuredGrid) {
+      // remove the cells which are only inside the old surface
+      const std::vector<psSmartPointer<lsDomain<T, D>>> cutLevelSets = {
+          makeDepthPlane(), levelSets->back(), surface};
+      visitVoxels(cutLevelSets,
+                  [&](const std::array<int, D> &indices, unsigned materialId) {
+                    const int cellIdx = getCellAt(indices);
+                    if (materialId == 2 && cellIdx >= 0)
+                      removeCell[cellIdx] = 1;
+                  });
+
+      // add the cells which are now within the band of the new surface
+      if (surfaceBandWidth > 0.) {
+        std::vector<std::array<int, D>> newCells;
+        std::vector<T> newMaterialIds;
+        visitVoxels(
+            getLevelSetsInOrder(),
+            [&](const std::array<int, D> &indices, unsigned materialId) {
+              if (getCellAt(indices) >= 0)
+                return;
+              newCells.push_back(indices);
+              newMaterialIds.push_back(getLevelSetMaterial(materialId));
+            },
+            makeSurfaceBand());
+        appendCells(newCells, newMaterialIds);
+        numNewCells = newCells.size();
+        removeCell.resize(numberOfCells, 0);
+      }
+    } else {
+      auto updateCellGrid = psSmartPointer<lsMesh<T>>::New();
+
+      lsToVoxelMesh<T, D> voxelConverter(updateCellGrid);
+      voxelConverter.insertNextLevelSet(makeDepthPlane());
+      voxelConverter.insertNextLevelSet(levelSets->back());
+      voxelConverter.insertNextLevelSet(surface);
+      voxelConverter.apply();
+
+      auto cutMatIds = updateCellGrid->getCellData().getScalarData("Material");
+      const auto nCutCells = std::min(
+          updateCellGrid->template getElements<(1 << D)>().size(),
+          numberOfCells);
+      for (std::size_t elIdx = 0; elIdx < nCutCells; elIdx++) {
+        if (cutMatIds->at(elIdx) == 2)
+          removeCell[elIdx] = 1;
       }
     }
-    numberOfCells = hexas.size();
+
+    removeCells(removeCell);
     surface->deepCopy(levelSets->back());
+    buildCellLattice();
 
-    buildBVH();
+    // the added cells are found in the updated lattice
+    if (numNewCells > 0 && cellNeighbors.size() == numberOfCells)
+      connectNewCells(numberOfCells - numNewCells);
   }
 
   // Merge a trace path to the cell set.
@@ -506,112 +592,366 @@ public:
     }
   }
 
+  // Find the neighbors of all cells. The neighbors are looked up in the cell
+  // lattice at the grid indices offset by one in each direction; in periodic
+  // directions, the indices wrap around the bounds of the cell set. The
+  // neighborhood is kept up to date by updateSurface.
   void buildNeighborhood() {
     psUtils::Timer timer;
     timer.start();
-    const auto &cells = cellGrid->template getElements<(1 << D)>();
-    const auto &nodes = cellGrid->getNodes();
-    unsigned const numNodes = nodes.size();
-    unsigned const numCells = cells.size();
-    cellNeighbors.resize(numCells);
-    const bool usePeriodicBoundary = periodicBoundary.any();
-
-    std::vector<std::vector<unsigned>> nodeCellConnections(numNodes);
-
-    // for each node, store which cells are connected with the node
-    for (unsigned cellIdx = 0; cellIdx < numCells; cellIdx++) {
-      for (unsigned cellNodeIdx = 0; cellNodeIdx < (1 << D); cellNodeIdx++) {
-        nodeCellConnections[cells[cellIdx][cellNodeIdx]].push_back(cellIdx);
-      }
+    std::array<int, D> minCell, maxCell;
+    getCellBounds(minCell, maxCell);
+    cellNeighbors.resize(numberOfCells);
+
+#pragma omp parallel for schedule(static)
+    for (long cellIdx = 0; cellIdx < static_cast<long>(numberOfCells);
+         cellIdx++) {
+      findNeighbors(cellIdx, minCell, maxCell);
+    }
+    timer.finish();
+    psLogger::getInstance()
+        .addTiming("Building cell set neighborhood structure took",
+                   timer.currentDuration * 1e-9)
+        .print();
+  }
+
+  const std::array<int, 2 * D> &getNeighbors(unsigned long cellIdx) {
+    assert(cellIdx < numberOfCells && "Cell idx out of bounds");
+    return cellNeighbors[cellIdx];
+  }
+
+private:
+  // Returns the index of the cell containing the point, or -1 if the point
+  // is outside of the cell set. A point on the face between cells belongs to
+  // the cell with the lowest index.
+  int findIndex(const csTriple<T> &point) {
+    if (cellLattice.empty())
+      return -1;
+
+    // lattice sites of all cells which could contain the point; neighboring
+    // sites are only checked if the point lies on a face
+    constexpr T tolerance = 1e-6;
+    std::array<int, 3> lower{0, 0, 0};
+    std::array<int, 3> upper{0, 0, 0};
+    for (int i = 0; i < D; ++i) {
+      const T x = point[i] / gridDelta;
+      const T cell = std::floor(x);
+      const int site = static_cast<int>(cell);
+      lower[i] = site - (x - cell < tolerance ? 1 : 0);
+      upper[i] = site + (cell + 1 - x < tolerance ? 1 : 0);
     }
 
-#pragma omp parallel for
-    for (unsigned cellIdx = 0; cellIdx < numCells; cellIdx++) {
-      auto coord = nodes[cells[cellIdx][0]];
-      for (int i = 0; i < D; i++) {
-        coord[i] += gridDelta / 2.;
-        cellNeighbors[cellIdx][i] = -1;
-        cellNeighbors[cellIdx][i + D] = -1;
+    int idx = -1;
+    for (int z = lower[2]; z <= upper[2]; ++z) {
+      for (int y = lower[1]; y <= upper[1]; ++y) {
+        for (int x = lower[0]; x <= upper[0]; ++x) {
+          const std::array<int, 3> site{x, y, z};
+          std::array<int, D> indices;
+          for (int i = 0; i < D; ++i)
+            indices[i] = site[i];
+          const int cellId = cellLattice.find(indices);
+          if (cellId >= 0 && (idx < 0 || cellId < idx) &&
+              isInsideVoxel(point, getCellMin(cellId)))
+            idx = cellId;
+        }
       }
+    }
+    return idx;
+  }
 
-      if (usePeriodicBoundary) {
-        auto onBoundary = isBoundaryCell(coord);
-        if (onBoundary.any()) {
-          /*look for neighbor cells using BVH*/
-          for (std::size_t i = 0; i < 2 * D; i++) {
-            auto neighborCoord = coord;
-            bool minBoundary = i % 2 == 0;
-
-            if (onBoundary.test(i)) {
-              // wrap around boundary
-              if (!minBoundary) {
-                neighborCoord[i / 2] =
-                    cellGrid->minimumExtent[i / 2] + gridDelta / 2.;
-              } else {
-                neighborCoord[i / 2] =
-                    cellGrid->maximumExtent[i / 2] - gridDelta / 2.;
-              }
-            } else {
-              neighborCoord[i / 2] += minBoundary ? -gridDelta : gridDelta;
-            }
-            cellNeighbors[cellIdx][i] = findIndex(neighborCoord);
-          }
-          continue;
+  // Returns the index of the cell with the given grid indices, or -1 if there
+  // is no such cell.
+  int getCellAt(const std::array<int, D> &indices) const {
+    return cellLattice.find(indices);
+  }
+
+  // Grid indices of the minimum corner of the cell.
+  std::array<int, D> getCellIndices(const unsigned long idx) const {
+    if (structuredGrid)
+      return cellIndices[idx];
+    const auto cellMin = getCellMin(idx);
+    std::array<int, D> indices;
+    for (int i = 0; i < D; ++i)
+      indices[i] = static_cast<int>(std::lround(cellMin[i] / gridDelta));
+    return indices;
+  }
+
+  // Add the nodes and elements of the cells with the given grid indices to
+  // the mesh. The nodes on the corners of the cells are numbered in order of
+  // appearance and the corners are ordered as in lsToVoxelMesh.
+  void generateCells(const std::vector<std::array<int, D>> &indices,
+                     lsMesh<T> &mesh) const {
+    if (indices.empty())
+      return;
+    std::array<int, D> minNodeIndex, maxNodeIndex;
+    minNodeIndex.fill(std::numeric_limits<int>::max());
+    maxNodeIndex.fill(std::numeric_limits<int>::lowest());
+    for (const auto &cell : indices) {
+      for (int i = 0; i < D; ++i) {
+        minNodeIndex[i] = std::min(minNodeIndex[i], cell[i]);
+        maxNodeIndex[i] = std::max(maxNodeIndex[i], cell[i] + 1);
+      }
+    }
+    csCellLattice<D> nodeLattice;
+    nodeLattice.initialize(minNodeIndex, maxNodeIndex);
+
+    constexpr auto cornerOrder = getVoxelCornerOrder();
+    auto &nodes = mesh.getNodes();
+    auto &elems = mesh.template getElements<(1 << D)>();
+    const std::size_t firstElem = elems.size();
+    elems.resize(firstElem + indices.size());
+    for (std::size_t cellIdx = 0; cellIdx < indices.size(); ++cellIdx) {
+      for (int corner = 0; corner < (1 << D); ++corner) {
+        auto nodeIndices = indices[cellIdx];
+        for (int i = 0; i < D; ++i)
+          nodeIndices[i] += (cornerOrder[corner] >> i) & 1;
+
+        int nodeId = nodeLattice.find(nodeIndices);
+        if (nodeId < 0) {
+          csTriple<T> node{0., 0., 0.};
+          for (int i = 0; i < D; ++i)
+            node[i] = nodeIndices[i] * gridDelta;
+          nodeId = nodes.size();
+          nodes.push_back(node);
+          nodeLattice.insert(nodeIndices, nodeId);
         }
+        elems[firstElem + cellIdx][corner] = nodeId;
       }
+    }
+  }
 
-      for (unsigned cellNodeIdx = 0; cellNodeIdx < (1 << D); cellNodeIdx++) {
-        auto &cellsAtNode = nodeCellConnections[cells[cellIdx][cellNodeIdx]];
+  // Corners of a voxel in the order in which lsToVoxelMesh stores them in the
+  // elements. Bit i of a corner is set if it lies on the upper side of the
+  // voxel in direction i.
+  static constexpr std::array<int, (1 << D)> getVoxelCornerOrder() {
+    if constexpr (D == 3)
+      return {0, 1, 3, 2, 4, 5, 7, 6};
+    else
+      return {0, 2, 3, 1};
+  }
 
-        for (const auto &neighborCell : cellsAtNode) {
-          if (neighborCell != cellIdx) {
+  csTriple<T> getCellMin(const unsigned long idx) const {
+    if (!structuredGrid) {
+      const auto &elems = cellGrid->template getElements<(1 << D)>();
+      return cellGrid->getNodes()[elems[idx][0]];
+    }
+    csTriple<T> cellMin{0., 0., 0.};
+    for (int i = 0; i < D; ++i)
+      cellMin[i] = cellIndices[idx][i] * gridDelta;
+    return cellMin;
+  }
 
-            auto neighborCoord = nodes[cells[neighborCell][0]];
-            for (int i = 0; i < D; i++)
-              neighborCoord[i] += gridDelta / 2.;
+  psSmartPointer<lsDomain<T, D>> makeDepthPlane() const {
+    auto plane = psSmartPointer<lsDomain<T, D>>::New(surface->getGrid());
+    T origin[D] = {0.};
+    T normal[D] = {0.};
+    origin[D - 1] = depth;
+    normal[D - 1] = 1.;
+    lsMakeGeometry<T, D>(plane,
+                         psSmartPointer<lsPlane<T, D>>::New(origin, normal))
+        .apply();
+    return plane;
+  }
 
-            if (csUtil::distance(coord, neighborCoord) < gridDelta + eps) {
+  // The level sets making up the cell set, including the plane at the depth
+  // of the cell set.
+  std::vector<psSmartPointer<lsDomain<T, D>>> getLevelSetsInOrder() const {
+    std::vector<psSmartPointer<lsDomain<T, D>>> levelSetsInOrder;
+    auto plane = makeDepthPlane();
+    if (!cellSetAboveSurface)
+      levelSetsInOrder.push_back(plane);
+    for (auto ls : *levelSets)
+      levelSetsInOrder.push_back(ls);
+    if (cellSetAboveSurface)
+      levelSetsInOrder.push_back(plane);
+    return levelSetsInOrder;
+  }
 
-              for (int i = 0; i < D; i++) {
-                if (coord[i] - neighborCoord[i] > gridDelta / 2.) {
-                  cellNeighbors[cellIdx][i * 2] = neighborCell;
-                } else if (coord[i] - neighborCoord[i] < -gridDelta / 2.) {
-                  cellNeighbors[cellIdx][i * 2 + 1] = neighborCell;
-                }
-              }
-            }
-          }
+  // Visit all voxels of the level sets between minIndex and maxIndex in the
+  // same order as lsToVoxelMesh. The voxel belongs to the first level set
+  // which contains its center; the function is called with the grid indices
+  // of the minimum corner of the voxel and the index of that level set. If a
+  // surface band is passed, voxels further than the surface band width from
+  // its surface are skipped.
+  template <class VoxelFunction>
+  void visitVoxels(
+      const std::vector<psSmartPointer<lsDomain<T, D>>> &levelSetsInOrder,
+      VoxelFunction visit,
+      psSmartPointer<lsDomain<T, D>> surfaceBand = nullptr) const {
+    using DomainType = typename lsDomain<T, D>::DomainType;
+    std::vector<hrleConstDenseCellIterator<DomainType>> iterators;
+    for (auto &ls : levelSetsInOrder)
+      iterators.push_back(
+          hrleConstDenseCellIterator<DomainType>(ls->getDomain(), minIndex));
+    if (surfaceBand)
+      iterators.push_back(hrleConstDenseCellIterator<DomainType>(
+          surfaceBand->getDomain(), minIndex));
+    // level set values are in units of the grid delta
+    const T maxBandValue = surfaceBandWidth / gridDelta * T(1 << D);
+
+    for (; iterators.front().getIndices() < maxIndex;
+         iterators.front().next()) {
+      if (surfaceBand) {
+        auto &bandIt = iterators.back();
+        bandIt.goToIndicesSequential(iterators.front().getIndices());
+        T centerValue = 0.;
+        for (int i = 0; i < (1 << D); ++i)
+          centerValue += bandIt.getCorner(i).getValue();
+        if (std::abs(centerValue) > maxBandValue)
+          continue;
+      }
+
+      for (unsigned materialId = 0; materialId < levelSetsInOrder.size();
+           ++materialId) {
+        auto &cellIt = iterators[materialId];
+        cellIt.goToIndicesSequential(iterators.front().getIndices());
+
+        // find out whether the centre of the box is inside
+        T centerValue = 0.;
+        for (int i = 0; i < (1 << D); ++i)
+          centerValue += cellIt.getCorner(i).getValue();
+        if (centerValue > 0.)
+          continue;
+
+        // the voxel is only created if all corners are in bounds
+        std::array<int, D> indices;
+        bool isVoxel = true;
+        for (int j = 0; j < D; ++j) {
+          indices[j] = cellIt.getIndices(j);
+          if (indices[j] + 1 > maxIndex[j])
+            isVoxel = false;
         }
+        if (isVoxel)
+          visit(indices, materialId);
+        break;
       }
     }
-    timer.finish();
-    psLogger::getInstance()
-        .addTiming("Building cell set neighborhood structure took",
-                   timer.currentDuration * 1e-9)
-        .print();
   }
 
-  const std::array<int, 2 * D> &getNeighbors(unsigned long cellIdx) {
-    assert(cellIdx < numberOfCells && "Cell idx out of bounds");
-    return cellNeighbors[cellIdx];
+  // Create the cells of the structured grid directly from the level sets, in
+  // the same order as lsToVoxelMesh would create them.
+  void createStructuredCells(
+      const std::vector<psSmartPointer<lsDomain<T, D>>> &levelSetsInOrder) {
+    cellIndices.clear();
+    std::vector<T> materialIds;
+    visitVoxels(
+        levelSetsInOrder,
+        [&](const std::array<int, D> &indices, unsigned materialId) {
+          cellIndices.push_back(indices);
+          materialIds.push_back(materialId);
+        },
+        surfaceBandWidth > 0. ? makeSurfaceBand() : nullptr);
+    cellIndices.shrink_to_fit();
+
+    cellGrid->clear();
+    cellGrid->getCellData().insertNextScalarData(std::move(materialIds),
+                                                 "Material");
+    numberOfCells = cellIndices.size();
+    calculateCellExtent();
   }
 
-private:
-  int findIndex(const csTriple<T> &point) {
-    const auto &elems = cellGrid->template getElements<(1 << D)>();
-    const auto &nodes = cellGrid->getNodes();
-    int idx = -1;
+  // Set the extent of the cell grid from the cell indices, as it is saved by
+  // lsToVoxelMesh, and widen it by eps. The extent bounds the particles
+  // traced in the cell set, so it has to be updated whenever cells are added
+  // or removed.
+  void calculateCellExtent() {
+    cellGrid->minimumExtent = {0., 0., 0.};
+    cellGrid->maximumExtent = {0., 0., 0.};
+    if (numberOfCells == 0)
+      return;
+    std::array<int, D> minCell, maxCell;
+    minCell.fill(std::numeric_limits<int>::max());
+    maxCell.fill(std::numeric_limits<int>::lowest());
+    for (std::size_t cellIdx = 0; cellIdx < numberOfCells; ++cellIdx) {
+      const auto cell = getCellIndices(cellIdx);
+      for (int i = 0; i < D; ++i) {
+        minCell[i] = std::min(minCell[i], cell[i]);
+        maxCell[i] = std::max(maxCell[i], cell[i]);
+      }
+    }
+    for (int i = 0; i < D; ++i) {
+      cellGrid->minimumExtent[i] = minCell[i] * gridDelta - eps;
+      cellGrid->maximumExtent[i] = (maxCell[i] + 1) * gridDelta + eps;
+    }
+  }
 
-    auto cellIds = BVH->getCellIds(point);
-    if (!cellIds)
-      return idx;
-    for (const auto cellId : *cellIds) {
-      if (isInsideVoxel(point, nodes[elems[cellId][0]])) {
-        idx = cellId;
-        break;
+  // Copy of the surface with a narrow band wide enough to hold the distance
+  // to all cells within the surface band width.
+  psSmartPointer<lsDomain<T, D>> makeSurfaceBand() const {
+    auto band = psSmartPointer<lsDomain<T, D>>::New(levelSets->back());
+    const int width =
+        2 * (static_cast<int>(std::ceil(surfaceBandWidth / gridDelta)) + 2);
+    lsExpand<T, D>(band, width).apply();
+    return band;
+  }
+
+  // Append cells with the given materials to the structured grid. All other
+  // cell data of the new cells is set to 0.
+  void appendCells(const std::vector<std::array<int, D>> &newCells,
+                   const std::vector<T> &newMaterialIds) {
+    if (newCells.empty())
+      return;
+    if (cellNeighbors.size() == numberOfCells) {
+      std::array<int, 2 * D> noNeighbors;
+      noNeighbors.fill(-1);
+      cellNeighbors.resize(numberOfCells + newCells.size(), noNeighbors);
+    }
+    cellIndices.insert(cellIndices.end(), newCells.begin(), newCells.end());
+
+    auto &cellData = cellGrid->getCellData();
+    for (unsigned d = 0; d < cellData.getScalarDataSize(); ++d)
+      cellData.getScalarData(d)->resize(cellIndices.size(), 0.);
+    auto materialIds = getScalarData("Material");
+    std::copy(newMaterialIds.begin(), newMaterialIds.end(),
+              materialIds->begin() + numberOfCells);
+    numberOfCells = cellIndices.size();
+    calculateCellExtent();
+  }
+
+  // Remove the marked cells, keeping the order of the remaining cells. If the
+  // neighborhood was built, it is updated to the new cell indices.
+  void removeCells(const std::vector<char> &removeCell) {
+    std::vector<std::size_t> keptCells;
+    keptCells.reserve(numberOfCells);
+    for (std::size_t i = 0; i < numberOfCells; ++i)
+      if (!removeCell[i])
+        keptCells.push_back(i);
+    if (keptCells.size() == numberOfCells)
+      return;
+
+    auto compact = [&keptCells](auto &values) {
+      for (std::size_t j = 0; j < keptCells.size(); ++j)
+        values[j] = values[keptCells[j]];
+      values.resize(keptCells.size());
+    };
+    if (structuredGrid)
+      compact(cellIndices);
+    else
+      compact(cellGrid->template getElements<(1 << D)>());
+    auto &cellData = cellGrid->getCellData();
+    for (unsigned d = 0; d < cellData.getScalarDataSize(); ++d)
+      compact(*cellData.getScalarData(d));
+
+    if (cellNeighbors.size() == numberOfCells) {
+      std::vector<int> newIds(numberOfCells, -1);
+      for (std::size_t j = 0; j < keptCells.size(); ++j)
+        newIds[keptCells[j]] = j;
+
+      std::vector<std::array<int, 2 * D>> keptNeighbors(keptCells.size());
+#pragma omp parallel for schedule(static)
+      for (long j = 0; j < static_cast<long>(keptCells.size()); ++j) {
+        for (int k = 0; k < 2 * D; ++k) {
+          const int neighbor = cellNeighbors[keptCells[j]][k];
+          keptNeighbors[j][k] = neighbor < 0 ? -1 : newIds[neighbor];
+        }
       }
+      cellNeighbors.swap(keptNeighbors);
+    } else {
+      cellNeighbors.clear();
     }
-    return idx;
+    numberOfCells = keptCells.size();
+    if (structuredGrid)
+      calculateCellExtent();
   }
 
   void adjustMaterialIds() {
@@ -619,18 +959,22 @@ private:
 
 #pragma omp parallel for
     for (size_t i = 0; i < matIds->size(); i++) {
-      int materialId = static_cast<int>(matIds->at(i));
+      matIds->at(i) = getLevelSetMaterial(static_cast<int>(matIds->at(i)));
+    }
+  }
 
-      if (!cellSetAboveSurface && materialId > 0) {
-        materialId -= 1;
-      }
+  // Material of the cells created from the level set with the given index in
+  // the ordered level sets.
+  int getLevelSetMaterial(int materialId) const {
+    if (!materialMap)
+      return materialId;
 
-      assert(materialId >= 0);
-      if (materialMap) {
-        matIds->at(i) =
-            static_cast<int>(materialMap->getMaterialAtIdx(materialId));
-      }
+    if (!cellSetAboveSurface && materialId > 0) {
+      materialId -= 1;
     }
+
+    assert(materialId >= 0);
+    return static_cast<int>(materialMap->getMaterialAtIdx(materialId));
   }
 
   int findSurfaceHitPoint(csTriple<T> &hitPoint, const csTriple<T> &direction) {
@@ -663,26 +1007,31 @@ private:
              point[1] >= cellMin[1] && point[1] <= (cellMin[1] + gridDelta);
   }
 
-  void buildBVH() {
+  void buildCellLattice() {
     psUtils::Timer timer;
     timer.start();
-    auto &elems = cellGrid->template getElements<(1 << D)>();
-    auto &nodes = cellGrid->getNodes();
-    BVH->clearCellIds();
-
-    for (size_t elemIdx = 0; elemIdx < elems.size(); elemIdx++) {
-      for (size_t n = 0; n < (1 << D); n++) {
-        auto &node = nodes[elems[elemIdx][n]];
-        auto cell = BVH->getCellIds(node);
-        if (cell == nullptr) {
-          psLogger::getInstance().addError("BVH building error.").print();
-        }
-        cell->insert(elemIdx);
+    cellLattice.clear();
+    if (numberOfCells == 0)
+      return;
+
+    std::array<int, D> latticeMin, latticeMax;
+    latticeMin.fill(std::numeric_limits<int>::max());
+    latticeMax.fill(std::numeric_limits<int>::lowest());
+    for (size_t elemIdx = 0; elemIdx < numberOfCells; elemIdx++) {
+      const auto indices = getCellIndices(elemIdx);
+      for (int i = 0; i < D; ++i) {
+        latticeMin[i] = std::min(latticeMin[i], indices[i]);
+        latticeMax[i] = std::max(latticeMax[i], indices[i]);
       }
     }
+
+    cellLattice.initialize(latticeMin, latticeMax);
+    for (size_t elemIdx = 0; elemIdx < numberOfCells; elemIdx++)
+      cellLattice.insert(getCellIndices(elemIdx), elemIdx);
     timer.finish();
     psLogger::getInstance()
-        .addTiming("Building cell set BVH took", timer.currentDuration * 1e-9)
+        .addTiming("Building cell set lattice took",
+                   timer.currentDuration * 1e-9)
         .print();
   }
 
@@ -708,21 +1057,54 @@ private:
     }
   }
 
-  std::bitset<2 * D> isBoundaryCell(const std::array<T, 3> &cellCoord) {
-    std::bitset<2 * D> onBoundary;
-    for (int i = 0; i < 2 * D; i += 2) {
-      if (!periodicBoundary[i / 2])
-        continue;
-      if (cellCoord[i / 2] - cellGrid->minimumExtent[i / 2] < gridDelta) {
-        /* cell is at min boundary */
-        onBoundary.set(i);
+  // Grid indices of the first and last cells in each direction, taken from
+  // the extent of the cell set.
+  void getCellBounds(std::array<int, D> &minCell,
+                     std::array<int, D> &maxCell) const {
+    for (int i = 0; i < D; ++i) {
+      const T minExtent = cellGrid->minimumExtent[i] / gridDelta;
+      const T maxExtent = cellGrid->maximumExtent[i] / gridDelta;
+      minCell[i] = static_cast<int>(std::lround(minExtent));
+      maxCell[i] = static_cast<int>(std::lround(maxExtent)) - 1;
+    }
+  }
+
+  void findNeighbors(const unsigned long cellIdx,
+                     const std::array<int, D> &minCell,
+                     const std::array<int, D> &maxCell) {
+    const auto indices = getCellIndices(cellIdx);
+    for (int i = 0; i < D; ++i) {
+      for (int side = 0; side < 2; ++side) {
+        auto neighbor = indices;
+        neighbor[i] += side == 0 ? -1 : 1;
+        if (periodicBoundary[i]) {
+          if (neighbor[i] < minCell[i])
+            neighbor[i] = maxCell[i];
+          else if (neighbor[i] > maxCell[i])
+            neighbor[i] = minCell[i];
+        }
+        cellNeighbors[cellIdx][2 * i + side] = cellLattice.find(neighbor);
       }
-      if (cellGrid->maximumExtent[i / 2] - cellCoord[i / 2] < gridDelta) {
-        /* cell is at max boundary */
-        onBoundary.set(i + 1);
+    }
+  }
+
+  // Find the neighbors of the cells from firstNewCell on and link the
+  // existing cells back to them.
+  void connectNewCells(const std::size_t firstNewCell) {
+    std::array<int, D> minCell, maxCell;
+    getCellBounds(minCell, maxCell);
+    const long numCells = numberOfCells;
+
+#pragma omp parallel for schedule(static)
+    for (long cellIdx = firstNewCell; cellIdx < numCells; cellIdx++) {
+      findNeighbors(cellIdx, minCell, maxCell);
+      // every direction of an existing cell has at most one new neighbor
+      for (int k = 0; k < 2 * D; ++k) {
+        const int neighbor = cellNeighbors[cellIdx][k];
+        if (neighbor >= 0 && static_cast<std::size_t>(neighbor) < firstNewCell)
+          cellNeighbors[neighbor][k ^ 1] = cellIdx;
       }
     }
-    return onBoundary;
   }
 };
 
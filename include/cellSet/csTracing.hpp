@@ -138,8 +138,6 @@ public:
   void averageNeighborhood() {
     auto data = cellSet->getFillingFractions();
     auto materialIds = cellSet->getScalarData("Material");
-    const auto &elems = cellSet->getElements();
-    const auto &nodes = cellSet->getNodes();
     std::vector<T> average(data->size(), 0.);
 
 #pragma omp parallel for
@@ -155,7 +153,7 @@ public:
       average[i] += data->at(i);
 
       for (int d = 0; d < D; d++) {
-        auto mid = calcMidPoint(nodes[elems[i][0]]);
+        auto mid = cellSet->getCellCenter(i);
         mid[d] -= mGridDelta;
         auto elemId = cellSet->getIndex(mid);
         if (elemId >= 0) {
@@ -188,8 +186,6 @@ public:
   void averageNeighborhoodSingleMaterial(int materialId) {
     auto data = cellSet->getFillingFractions();
     auto materialIds = cellSet->getScalarData("Material");
-    const auto &elems = cellSet->getElements();
-    const auto &nodes = cellSet->getNodes();
     std::vector<T> average(data->size(), 0.);
 
 #pragma omp parallel for
@@ -200,7 +196,7 @@ public:
       int numNeighbors = 1;
       average[i] += data->at(i);
       for (int d = 0; d < D; d++) {
-        auto mid = calcMidPoint(nodes[elems[i][0]]);
+        auto mid = cellSet->getCellCenter(i);
         mid[d] -= mGridDelta;
         auto elemId = cellSet->getIndex(mid);
         if (elemId >= 0) {
@@ -246,12 +242,6 @@ private:
     mGeometry.setMaterialIds(materialIds);
   }
 
-  inline csTriple<T> calcMidPoint(const csTriple<T> &minNode) {
-    return csTriple<T>{minNode[0] + mGridDelta / T(2),
-                       minNode[1] + mGridDelta / T(2),
-                       minNode[2] + mGridDelta / T(2)};
-  }
-
   void initMemoryFlags() {
 #ifdef ARCH_X86
     // for best performance set FTZ and DAZ flags in MXCSR control and status
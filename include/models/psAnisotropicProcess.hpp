@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
 #include <psMaterials.hpp>
 #include <psProcessModel.hpp>
 
@@ -21,7 +26,11 @@ class VelocityField : public psVelocityField<NumericType> {
   const NumericType r110;
   const NumericType r111;
   const NumericType r311;
-  const std::vector<std::pair<psMaterial, NumericType>> &materials;
+  // rate factor of each material returned by psMaterialMap::mapToMaterial,
+  // indexed by the material id + 1 (so psMaterial::None is at 0); zero for
+  // materials which are not processed
+  std::array<NumericType, static_cast<int>(psMaterial::GAS) + 1>
+      materialRates{};
 
 public:
   VelocityField(
@@ -31,8 +40,7 @@ public:
       const NumericType passedR111, const NumericType passedR311,
       const std::vector<std::pair<psMaterial, NumericType>> &passedmaterials)
       : direction100(passedDir100), direction010(passedDir010),
-        r100(passedR100), r110(passedR110), r111(passedR111), r311(passedR311),
-        materials(passedmaterials) {
+        r100(passedR100), r110(passedR110), r111(passedR111), r311(passedR311) {
 
     rayInternal::Normalize(direction100);
     rayInternal::Normalize(direction010);
@@ -45,52 +53,87 @@ public:
         Scale(rayInternal::DotProduct(directions[0], directions[1]),
               directions[0]));
     directions[2] = rayInternal::CrossProduct(directions[0], directions[1]);
+
+    // the first entry of a material is used, so fill the table backwards
+    for (auto it = passedmaterials.rbegin(); it != passedmaterials.rend();
+         ++it) {
+      const int id = static_cast<int>(it->first);
+      if (id >= -1 && id + 1 < static_cast<int>(materialRates.size()))
+        materialRates[id + 1] = it->second;
+    }
   }
 
   NumericType
   getScalarVelocity(const std::array<NumericType, 3> & /*coordinate*/,
                     int material, const std::array<NumericType, 3> &nv,
                     unsigned long /*pointID*/) override {
-    for (auto epitaxyMaterial : materials) {
-      if (psMaterialMap::isMaterial(material, epitaxyMaterial.first)) {
-        if (std::abs(rayInternal::Norm(nv) - 1.) > 1e-4)
-          return 0.;
-
-        std::array<NumericType, 3> normalVector;
-        normalVector[0] = nv[0];
-        normalVector[1] = nv[1];
-        if (D == 3) {
-          normalVector[2] = nv[2];
-        } else {
-          normalVector[2] = 0;
-        }
-        rayInternal::Normalize(normalVector);
-
-        std::array<NumericType, 3> N;
-        for (int i = 0; i < 3; i++) {
-          N[i] =
-              std::fabs(rayInternal::DotProduct(directions[i], normalVector));
-        }
-        std::sort(N.begin(), N.end(), std::greater<NumericType>());
-
-        NumericType velocity;
-        if (rayInternal::DotProduct(
-                N, std::array<NumericType, 3>{-1., 1., 2.}) < 0) {
-          velocity = (r100 * (N[0] - N[1] - 2 * N[2]) + r110 * (N[1] - N[2]) +
-                      3 * r311 * N[2]) /
-                     N[0];
-        } else {
-          velocity = (r111 * ((N[1] - N[0]) * 0.5 + N[2]) +
-                      r110 * (N[1] - N[2]) + 1.5 * r311 * (N[0] - N[1])) /
-                     N[0];
-        }
-
-        return velocity * epitaxyMaterial.second;
-      }
+    const NumericType rate = getMaterialRate(material);
+    if (rate == 0.)
+      return 0.;
+    return rate * getCrystalVelocity(nv);
+  }
+
+  // Evaluate the velocities of a batch of points. Without the material
+  // search and with a branchless crystal plane formula, the loop can be
+  // vectorized.
+  void getScalarVelocities(
+      const std::vector<std::array<NumericType, 3>> &normalVectors,
+      const std::vector<int> &materialIds,
+      std::vector<NumericType> &velocities) const {
+    const long numPoints = normalVectors.size();
+    velocities.resize(numPoints);
+#pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < numPoints; ++i) {
+      velocities[i] = getMaterialRate(materialIds[i]) *
+                      getCrystalVelocity(normalVectors[i]);
     }
+  }
+
+  NumericType getMaterialRate(const int material) const {
+    const auto id = static_cast<int>(psMaterialMap::mapToMaterial(material));
+    return materialRates[id + 1];
+  }
 
-    // not an epitaxy material
-    return 0.;
+  // Velocity of the crystal plane with the given normal vector, relative to
+  // the material rate. Zero if the normal vector is not normalized. The
+  // formula is invariant to the length of the projected normal vector, so it
+  // does not have to be normalized again.
+  NumericType getCrystalVelocity(const std::array<NumericType, 3> &nv) const {
+    const NumericType normSquared =
+        nv[0] * nv[0] + nv[1] * nv[1] + nv[2] * nv[2];
+    // bitwise and, so the check does not introduce a branch
+    const bool isValid = normSquared >= (1. - 1e-4) * (1. - 1e-4) &
+                         normSquared <= (1. + 1e-4) * (1. + 1e-4);
+
+    const NumericType nx = nv[0];
+    const NumericType ny = nv[1];
+    const NumericType nz = D == 3 ? nv[2] : 0.;
+    NumericType n0 = std::abs(directions[0][0] * nx + directions[0][1] * ny +
+                              directions[0][2] * nz);
+    NumericType n1 = std::abs(directions[1][0] * nx + directions[1][1] * ny +
+                              directions[1][2] * nz);
+    NumericType n2 = std::abs(directions[2][0] * nx + directions[2][1] * ny +
+                              directions[2][2] * nz);
+
+    // sorting network, descending
+    NumericType hi = std::max(n0, n1);
+    n1 = std::min(n0, n1);
+    n0 = hi;
+    hi = std::max(n1, n2);
+    n2 = std::min(n1, n2);
+    n1 = hi;
+    hi = std::max(n0, n1);
+    n1 = std::min(n0, n1);
+    n0 = hi;
+
+    // evaluate both pieces and select one, which compiles to a blend
+    const NumericType lower = r100 * (n0 - n1 - 2 * n2) + r110 * (n1 - n2) +
+                              3 * r311 * n2;
+    const NumericType upper = r111 * ((n1 - n0) * 0.5 + n2) +
+                              r110 * (n1 - n2) + 1.5 * r311 * (n0 - n1);
+    const NumericType velocity = ((-n0 + n1 + 2 * n2) < 0 ? lower : upper) / n0;
+
+    return isValid ? velocity : NumericType(0.);
   }
 
   // the translation field should be disabled when using a surface model
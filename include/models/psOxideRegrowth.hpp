@@ -200,8 +200,6 @@ private:
                          const T timeStep) {
     auto data = cellSet->getFillingFractions();
     auto materialIds = cellSet->getScalarData("Material");
-    auto elems = cellSet->getElements();
-    auto nodes = cellSet->getNodes();
     const auto gridDelta = cellSet->getGridDelta();
     // calculate time discretization
     const T dt = std::min(gridDelta * gridDelta / diffusionCoefficient *
@@ -222,10 +220,7 @@ private:
         }
 
         int numNeighbors = 0;
-        auto coord = nodes[elems[e][0]];
-        for (int i = 0; i < D; i++) {
-          coord[i] += gridDelta / 2.;
-        }
+        const auto coord = cellSet->getCellCenter(e);
 
         auto cellNeighbors = cellSet->getNeighbors(e);
         for (const auto &n : cellNeighbors) {
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <lsMesh.hpp>
+
+#include <psLogger.hpp>
+#include <psSmartPointer.hpp>
+#include <psVTKWriter.hpp>
+
+/// Writes meshes to VTK files on a background thread, so the simulation does
+/// not have to wait for the file output. The passed meshes must not be
+/// modified afterwards; pass a copy if the mesh is still in use. If the
+/// maximum number of meshes is already waiting to be written, write() blocks
+/// until a mesh has been written, which bounds the memory used for the queue.
+template <class NumericType> class psAsyncVTKWriter {
+  using meshType = psSmartPointer<lsMesh<NumericType>>;
+
+  std::deque<std::pair<meshType, std::string>> queue;
+  std::size_t maxQueueSize = 2;
+  bool isWriting = false;
+  bool stopWorker = false;
+  std::mutex queueMutex;
+  std::condition_variable queueChanged;
+  std::thread worker;
+
+public:
+  psAsyncVTKWriter() {}
+
+  psAsyncVTKWriter(std::size_t passedMaxQueueSize)
+      : maxQueueSize(std::max(passedMaxQueueSize, std::size_t(1))) {}
+
+  psAsyncVTKWriter(const psAsyncVTKWriter &) = delete;
+  psAsyncVTKWriter &operator=(const psAsyncVTKWriter &) = delete;
+
+  ~psAsyncVTKWriter() {
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      stopWorker = true;
+    }
+    queueChanged.notify_all();
+    if (worker.joinable())
+      worker.join();
+  }
+
+  // Queue the mesh to be written to the file.
+  void write(meshType mesh, std::string fileName) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (!worker.joinable())
+      worker = std::thread(&psAsyncVTKWriter::run, this);
+    queueChanged.wait(lock, [this] { return queue.size() < maxQueueSize; });
+    queue.emplace_back(std::move(mesh), std::move(fileName));
+    lock.unlock();
+    queueChanged.notify_all();
+  }
+
+  // Wait until all queued meshes have been written.
+  void flush() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [this] { return queue.empty() && !isWriting; });
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+      queueChanged.wait(lock, [this] { return stopWorker || !queue.empty(); });
+      if (queue.empty())
+        return;
+
+      auto [mesh, fileName] = std::move(queue.front());
+      queue.pop_front();
+      isWriting = true;
+      lock.unlock();
+      queueChanged.notify_all();
+
+      psVTKWriter<NumericType>(mesh, fileName).apply();
+
+      lock.lock();
+      isWriting = false;
+      queueChanged.notify_all();
+    }
+  }
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <psKDTree.hpp>
+#include <psLogger.hpp>
+#include <psPointData.hpp>
+#include <psSmartPointer.hpp>
+#include <psUtils.hpp>
+
+/// Stores converged surface coverages, so the coverage initialization of
+/// later processes on the same (or a similar) geometry can start from them.
+/// Entries are identified by a hash of the surface geometry and a hash of the
+/// model parameters. The cache can be shared between processes running in
+/// parallel and can be saved to and loaded from a file.
+template <typename NumericType> class psCoverageCache {
+public:
+  struct Entry {
+    std::size_t geometryKey = 0;
+    std::size_t parameterKey = 0;
+    std::vector<std::array<NumericType, 3>> points;
+    psSmartPointer<psPointData<NumericType>> coverages = nullptr;
+  };
+
+private:
+  std::vector<Entry> entries;
+  mutable std::mutex cacheMutex;
+
+  static constexpr char fileIdentifier[] = "ViennaPS coverage cache";
+
+  const Entry *findOnGeometry(std::size_t geometryKey,
+                              std::size_t parameterKey) const {
+    const Entry *best = nullptr;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+      if (it->geometryKey != geometryKey)
+        continue;
+      if (it->parameterKey == parameterKey)
+        return &*it;
+      if (best == nullptr)
+        best = &*it;
+    }
+    return best;
+  }
+
+  // Every target point has a source point within maxDistance and both point
+  // sets have the same size.
+  static bool isClose(const std::vector<std::array<NumericType, 3>> &source,
+                      const std::vector<std::array<NumericType, 3>> &target,
+                      const NumericType maxDistance) {
+    if (source.empty() || source.size() != target.size())
+      return false;
+
+    psKDTree<NumericType, std::array<NumericType, 3>> kdTree(source);
+    kdTree.build();
+    for (const auto &point : target) {
+      if (kdTree.findNearest(point)->second > maxDistance)
+        return false;
+    }
+    return true;
+  }
+
+public:
+  psCoverageCache() {}
+
+  // Insert converged coverages for the given surface points. An existing entry
+  // with the same keys is replaced.
+  void insert(std::size_t geometryKey, std::size_t parameterKey,
+              const std::vector<std::array<NumericType, 3>> &points,
+              const psPointData<NumericType> &coverages) {
+    Entry entry;
+    entry.geometryKey = geometryKey;
+    entry.parameterKey = parameterKey;
+    entry.points = points;
+    entry.coverages = psSmartPointer<psPointData<NumericType>>::New(coverages);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto &e : entries) {
+      if (e.geometryKey == geometryKey && e.parameterKey == parameterKey) {
+        e = std::move(entry);
+        return;
+      }
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  // Find the entry which best matches the keys on the same geometry. An entry
+  // with the same parameters is preferred over the most recent entry on the
+  // geometry. Returns false if there is no entry on the geometry.
+  bool find(std::size_t geometryKey, std::size_t parameterKey,
+            Entry &result) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    const Entry *best = findOnGeometry(geometryKey, parameterKey);
+    if (best == nullptr)
+      return false;
+    result = *best;
+    return true;
+  }
+
+  // Find the entry which best matches the keys and the surface points. If
+  // there is no entry on the same geometry, entries on a close geometry are
+  // used: it has the same number of points and every point lies within
+  // maxDistance of a point of the entry. Returns false if no entry is close.
+  bool find(std::size_t geometryKey, std::size_t parameterKey,
+            const std::vector<std::array<NumericType, 3>> &points,
+            const NumericType maxDistance, Entry &result) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    const Entry *best = findOnGeometry(geometryKey, parameterKey);
+    for (auto it = entries.rbegin(); it != entries.rend() && !best; ++it) {
+      if (it->parameterKey == parameterKey &&
+          isClose(it->points, points, maxDistance))
+        best = &*it;
+    }
+    for (auto it = entries.rbegin(); it != entries.rend() && !best; ++it) {
+      if (isClose(it->points, points, maxDistance))
+        best = &*it;
+    }
+    if (best == nullptr)
+      return false;
+    result = *best;
+    return true;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return entries.size();
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    entries.clear();
+  }
+
+  // Hash of the surface geometry. Coordinates are compared on a fraction of
+  // the grid spacing, so identical level sets always produce the same key.
+  static std::size_t
+  hashGeometry(const std::vector<std::array<NumericType, 3>> &points,
+               const std::vector<NumericType> &materialIds,
+               const NumericType gridDelta) {
+    std::size_t seed = points.size();
+    const NumericType scale = 1e3 / gridDelta;
+    for (const auto &point : points) {
+      for (unsigned i = 0; i < 3; ++i)
+        hashCombine(seed, std::llround(point[i] * scale));
+    }
+    for (const auto id : materialIds)
+      hashCombine(seed, std::lround(id));
+    return seed;
+  }
+
+  template <class T> static void hashCombine(std::size_t &seed, const T &v) {
+    seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+
+  // Save all entries to a binary file.
+  void save(const std::string &fileName) const {
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+      psLogger::getInstance()
+          .addWarning("Could not open file " + fileName)
+          .print();
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    psUtils::writeBinary(file, std::string(fileIdentifier));
+    psUtils::writeBinary(file, static_cast<std::uint32_t>(sizeof(NumericType)));
+    psUtils::writeBinary(file, static_cast<std::uint64_t>(entries.size()));
+    for (const auto &entry : entries) {
+      psUtils::writeBinary(file, static_cast<std::uint64_t>(entry.geometryKey));
+      psUtils::writeBinary(file,
+                           static_cast<std::uint64_t>(entry.parameterKey));
+      psUtils::writeBinary(file, entry.points);
+      const auto &coverages = *entry.coverages;
+      psUtils::writeBinary(
+          file, static_cast<std::uint64_t>(coverages.getScalarDataSize()));
+      for (std::size_t i = 0; i < coverages.getScalarDataSize(); ++i) {
+        psUtils::writeBinary(file, coverages.getScalarDataLabel(i));
+        psUtils::writeBinary(file, *coverages.getScalarData(i));
+      }
+    }
+  }
+
+  // Load entries from a binary file written by save and add them to the
+  // cache.
+  void load(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+      psLogger::getInstance()
+          .addWarning("Could not open file " + fileName)
+          .print();
+      return;
+    }
+
+    std::string identifier;
+    std::uint32_t numericSize = 0;
+    std::uint64_t numEntries = 0;
+    psUtils::readBinary(file, identifier);
+    psUtils::readBinary(file, numericSize);
+    psUtils::readBinary(file, numEntries);
+    if (!file || identifier != fileIdentifier ||
+        numericSize != sizeof(NumericType)) {
+      psLogger::getInstance()
+          .addWarning("Incompatible coverage cache file " + fileName)
+          .print();
+      return;
+    }
+
+    std::vector<Entry> newEntries;
+    for (std::uint64_t n = 0; n < numEntries && file; ++n) {
+      Entry entry;
+      std::uint64_t geometryKey = 0, parameterKey = 0, numCoverages = 0;
+      psUtils::readBinary(file, geometryKey);
+      psUtils::readBinary(file, parameterKey);
+      psUtils::readBinary(file, entry.points);
+      psUtils::readBinary(file, numCoverages);
+      entry.geometryKey = geometryKey;
+      entry.parameterKey = parameterKey;
+      entry.coverages = psSmartPointer<psPointData<NumericType>>::New();
+      for (std::uint64_t i = 0; i < numCoverages && file; ++i) {
+        std::string label;
+        std::vector<NumericType> data;
+        psUtils::readBinary(file, label);
+        psUtils::readBinary(file, data);
+        entry.coverages->insertNextScalarData(std::move(data), label);
+      }
+      newEntries.push_back(std::move(entry));
+    }
+
+    if (!file) {
+      psLogger::getInstance()
+          .addWarning("Failed to read coverage cache file " + fileName)
+          .print();
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto &entry : newEntries)
+      entries.push_back(std::move(entry));
+  }
+};
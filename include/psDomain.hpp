@@ -15,6 +15,7 @@
 #include <psMaterials.hpp>
 #include <psSmartPointer.hpp>
 #include <psSurfacePointValuesToLevelSet.hpp>
+#include <psUtils.hpp>
 #include <psVTKWriter.hpp>
 
 /**
@@ -49,7 +50,10 @@ public:
   psDomain() : levelSets(lsDomainsType::New()) {}
 
   // Deep copy constructor.
-  psDomain(psSmartPointer<psDomain> passedDomain) { deepCopy(passedDomain); }
+  psDomain(psSmartPointer<psDomain> passedDomain)
+      : levelSets(lsDomainsType::New()) {
+    deepCopy(passedDomain);
+  }
 
   // Constructor for domain with a single initial Level-Set.
   psDomain(lsDomainType passedLevelSet, bool generateCellSet = false,
@@ -94,7 +98,12 @@ public:
     }
     if (passedDomain->cellSet) {
       cellSetDepth = passedDomain->cellSetDepth;
-      cellSet = csDomainType::New(levelSets, materialMap, cellSetDepth);
+      cellSet = csDomainType::New();
+      cellSet->setCellSetPosition(passedDomain->cellSet->getCellSetPosition());
+      cellSet->setStructuredGrid(passedDomain->cellSet->getStructuredGrid());
+      cellSet->setSurfaceBandWidth(
+          passedDomain->cellSet->getSurfaceBandWidth());
+      cellSet->fromLevelSets(levelSets, materialMap, cellSetDepth);
     } else {
       cellSet = nullptr;
     }
@@ -178,13 +187,20 @@ public:
   }
 
   // Generate the Cell-Set from the Level-Sets in the domain. The Cell-Set can
-  // be used to store and track volume data.
+  // be used to store and track volume data. A structured Cell-Set does not
+  // store a hexahedral mesh of the cells, which saves most of the memory. If
+  // a surface band width is set, only cells within this distance of the
+  // surface are created.
   void generateCellSet(const NumericType depth = 0.,
-                       const bool passedCellSetPosition = false) {
+                       const bool passedCellSetPosition = false,
+                       const bool passedStructuredGrid = false,
+                       const NumericType surfaceBandWidth = 0.) {
     cellSetDepth = depth;
     if (!cellSet)
       cellSet = csDomainType::New();
     cellSet->setCellSetPosition(passedCellSetPosition);
+    cellSet->setStructuredGrid(passedStructuredGrid);
+    cellSet->setSurfaceBandWidth(surfaceBandWidth);
     cellSet->fromLevelSets(levelSets, materialMap, cellSetDepth);
   }
 
@@ -282,6 +298,80 @@ public:
     }
   }
 
+  // Write the Level-Sets, the material map and the Cell-Set data of the domain
+  // to a binary stream.
+  std::ostream &serialize(std::ostream &stream) const {
+    psUtils::writeBinary(stream, static_cast<std::uint64_t>(levelSets->size()));
+    for (auto &ls : *levelSets) {
+      ls->serialize(stream);
+    }
+
+    std::vector<int> materials;
+    if (materialMap) {
+      for (std::size_t i = 0; i < materialMap->size(); i++) {
+        materials.push_back(static_cast<int>(materialMap->getMaterialAtIdx(i)));
+      }
+    }
+    psUtils::writeBinary(stream, static_cast<char>(materialMap != nullptr));
+    psUtils::writeBinary(stream, materials);
+
+    psUtils::writeBinary(stream, static_cast<char>(cellSet != nullptr));
+    if (cellSet)
+      cellSet->serialize(stream);
+
+    return stream;
+  }
+
+  // Read a domain written by serialize. The Level-Sets are read into the
+  // existing Level-Set objects if their number matches. The Cell-Set is
+  // restored from the stored cells, creating it if the domain has none. If
+  // the Cell-Set cannot be restored, the failbit of the stream is set.
+  std::istream &deserialize(std::istream &stream) {
+    std::uint64_t numLevelSets = 0;
+    psUtils::readBinary(stream, numLevelSets);
+    if (!stream)
+      return stream;
+    if (numLevelSets != levelSets->size()) {
+      levelSets->clear();
+      for (std::uint64_t i = 0; i < numLevelSets; i++) {
+        levelSets->push_back(lsDomainType::New());
+      }
+    }
+    for (auto &ls : *levelSets) {
+      ls->deserialize(stream);
+    }
+
+    char hasMaterialMap = 0;
+    std::vector<int> materials;
+    psUtils::readBinary(stream, hasMaterialMap);
+    psUtils::readBinary(stream, materials);
+    if (hasMaterialMap) {
+      materialMap = materialMapType::New();
+      for (auto material : materials) {
+        materialMap->insertNextMaterial(static_cast<psMaterial>(material));
+      }
+    } else {
+      materialMap = nullptr;
+    }
+
+    char hasCellSet = 0;
+    psUtils::readBinary(stream, hasCellSet);
+    if (!stream)
+      return stream;
+    if (hasCellSet) {
+      if (!cellSet)
+        cellSet = csDomainType::New();
+      if (cellSet->deserialize(stream, levelSets, materialMap))
+        cellSetDepth = cellSet->getDepth();
+      else
+        stream.setstate(std::ios::failbit);
+    } else {
+      cellSet = nullptr;
+    }
+
+    return stream;
+  }
+
   void clear() {
     levelSets = lsDomainsType::New();
     if (cellSet)
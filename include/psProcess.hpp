@@ -6,9 +6,13 @@
 #include <lsToDiskMesh.hpp>
 
 #include <psAdvectionCallback.hpp>
+#include <psAsyncVTKWriter.hpp>
+#include <psCoverageCache.hpp>
 #include <psDomain.hpp>
+#include <psKDTree.hpp>
 #include <psLogger.hpp>
 #include <psProcessModel.hpp>
+#include <psProcessProfile.hpp>
 #include <psSurfaceModel.hpp>
 #include <psTranslationField.hpp>
 #include <psVelocityField.hpp>
@@ -16,11 +20,21 @@
 #include <rayParticle.hpp>
 #include <rayTrace.hpp>
 
+// Norm of the change of the coverages between two iterations of the coverage
+// initialization.
+enum class psCoverageResidualNorm : unsigned {
+  MAX = 0, // largest change of any coverage value
+  L2 = 1   // L2 norm of all changes, divided by the root of their number
+};
+
 /// This class server as the main process tool, applying a user- or pre-defined
 /// process model to a domain. Depending on the user inputs surface advection, a
 /// single callback function or a geometric advection is applied.
 template <typename NumericType, int D> class psProcess {
-  using translatorType = std::unordered_map<unsigned long, unsigned long>;
+  using translatorType =
+      typename psTranslationField<NumericType>::translatorType;
+  using denseTranslatorType =
+      typename psTranslationField<NumericType>::denseTranslatorType;
   using psDomainType = psSmartPointer<psDomain<NumericType, D>>;
 
 public:
@@ -71,9 +85,112 @@ public:
   // number of points in the process geometry.
   void setNumberOfRaysPerPoint(unsigned numRays) { raysPerPoint = numRays; }
 
+  // Enable adaptive sampling of the fluxes. Each particle type is first traced
+  // with the set number of rays per point. As long as the relative flux error
+  // at 95 % of the hit surface points lies above the target, additional rays
+  // are traced and averaged with the previous result, up to the given maximum
+  // number of rays per point.
+  void enableAdaptiveRaysPerPoint(NumericType passedTargetRelativeError,
+                                  unsigned passedMaxRaysPerPoint) {
+    useAdaptiveRays = true;
+    targetRelativeError = passedTargetRelativeError;
+    maxRaysPerPoint = passedMaxRaysPerPoint;
+  }
+
+  // Disable adaptive sampling of the fluxes.
+  void disableAdaptiveRaysPerPoint() { useAdaptiveRays = false; }
+
+  // Set the weight of the newly traced rates when blending them with the rates
+  // of the previous time step (exponential moving average). The previous
+  // rates are mapped onto the current surface by a nearest neighbor search.
+  // A factor of 1 (default) disables blending. Smaller factors reduce the
+  // noise of the rates, so fewer rays per point are needed: the effective
+  // number of rays is about (2 - factor) / factor times the traced number.
+  void setFluxBlendingFactor(NumericType passedFactor) {
+    fluxBlendingFactor =
+        std::clamp(passedFactor, NumericType(0.), NumericType(1.));
+  }
+
+  // Periodically write a checkpoint of the running process to the given file,
+  // from which the process can be resumed. A checkpoint is written every
+  // `everyNSteps` advection steps and additionally whenever `everyNSeconds` of
+  // wall time have passed since the last checkpoint. A value of 0 disables
+  // the respective trigger.
+  void enableCheckpointing(std::string fileName, unsigned everyNSteps,
+                           double everyNSeconds = 0.) {
+    checkpointFileName = fileName;
+    checkpointSteps = everyNSteps;
+    checkpointSeconds = everyNSeconds;
+  }
+
+  void disableCheckpointing() { checkpointFileName.clear(); }
+
+  // Resume the process from a checkpoint file in the next call to apply().
+  // The level sets, material map and cell set data of the domain, the
+  // coverages, the particle data logs and the process time are restored, so
+  // the coverage initialization is skipped and the process continues with the
+  // time remaining when the checkpoint was written.
+  void resumeFromCheckpoint(std::string fileName) {
+    resumeFileName = fileName;
+  }
+
+  // Recalculate the fluxes only every `maxSteps` advection steps, or earlier
+  // once the surface may have moved more than `maxDisplacement` (in units of
+  // the grid delta) since the last flux calculation. A displacement of 0
+  // disables the displacement criterion. In the steps in between, the rates of
+  // the last flux calculation are mapped onto the advected surface. Defaults
+  // to 1, calculating the fluxes in every step.
+  void setFluxUpdateInterval(unsigned maxSteps,
+                             NumericType maxDisplacement = 0.) {
+    fluxUpdateSteps = std::max(maxSteps, 1u);
+    fluxUpdateDisplacement = maxDisplacement;
+  }
+
   // Set the number of iterations to initialize the coverages.
   void setMaxCoverageInitIterations(unsigned maxIt) { maxIterations = maxIt; }
 
+  // Set the tolerance for the coverage initialization. The initialization stops
+  // early once the change of the coverages between two iterations is below the
+  // tolerance. The change is measured by the maximum (default) or the L2 norm.
+  // A tolerance of 0 (default) always runs the maximum number of iterations.
+  void setCoverageConvergenceTolerance(
+      NumericType tolerance,
+      psCoverageResidualNorm norm = psCoverageResidualNorm::MAX) {
+    coverageConvergenceTolerance = tolerance;
+    coverageResidualNorm = norm;
+  }
+
+  // Set a cache of converged coverages. The coverage initialization starts
+  // from the best matching cache entry, mapped onto the current surface if the
+  // geometry differs, and the converged coverages are added to the cache
+  // afterwards. Seeded coverages converge faster when a convergence tolerance
+  // is set. The initialization always runs, since the cache can not tell
+  // apart models which differ only in their parameters.
+  void setCoverageCache(psSmartPointer<psCoverageCache<NumericType>> cache) {
+    coverageCache = cache;
+    coverageCacheKey.reset();
+  }
+
+  // Set a cache of converged coverages with a key identifying the model
+  // parameters. If the cache holds coverages for the same geometry and key,
+  // the initialization is skipped. The key has to change whenever a model
+  // parameter changes; the process name and process parameters are always
+  // included.
+  void setCoverageCache(psSmartPointer<psCoverageCache<NumericType>> cache,
+                        std::size_t parameterKey) {
+    coverageCache = cache;
+    coverageCacheKey = parameterKey;
+  }
+
+  // Returns the timings and ray counts of the last call to apply().
+  const psProcessProfile &getProfile() const { return profile; }
+
+  // Returns the change of the coverages in each iteration of the last coverage
+  // initialization, measured by the norm set with the convergence tolerance.
+  const std::vector<NumericType> &getCoverageResidualHistory() const {
+    return coverageResiduals;
+  }
+
   /// Enable flux smoothing. The flux at each surface point, calculated
   /// by the ray tracer, is averaged over the surface point neighbors.
   void enableFluxSmoothing() { smoothFlux = true; }
@@ -98,6 +215,18 @@ public:
   // are printed.
   void setPrintTimeInterval(NumericType passedTime) { printTime = passedTime; }
 
+  // Set the maximum distance (in units of the grid delta) any surface point
+  // may have moved since the ray tracing geometry was last built, for the
+  // geometry to be reused in the next flux calculation. The normal of each
+  // point may change by the same amount, which moves the rim of its disk by
+  // about as far. A reused geometry keeps the old positions and normals. The
+  // geometry is always rebuilt if the number of surface points changed.
+  // Defaults to 0, so the geometry is only reused if the surface did not move
+  // at all.
+  void setGeometryUpdateTolerance(NumericType passedTolerance) {
+    geometryUpdateTolerance = passedTolerance;
+  }
+
   // A single flux calculation is performed on the domain surface. The result is
   // stored as point data on the nodes of the mesh.
   psSmartPointer<lsMesh<NumericType>> calculateFlux() const {
@@ -139,9 +268,9 @@ public:
       rayTracer.setPrimaryDirection(primaryDirection.value());
     }
 
-    auto points = mesh->getNodes();
-    auto normals = *mesh->getCellData().getVectorData("Normals");
-    auto materialIds = *mesh->getCellData().getScalarData("MaterialIds");
+    auto &points = mesh->getNodes();
+    auto &normals = *mesh->getCellData().getVectorData("Normals");
+    auto &materialIds = *mesh->getCellData().getScalarData("MaterialIds");
     rayTracer.setGeometry(points, normals, domain->getGrid().getGridDelta());
     rayTracer.setMaterialIds(materialIds);
 
@@ -219,10 +348,25 @@ public:
       return;
     }
 
+    double remainingTime = processDuration;
+    double previousTimeStep = 0.;
+    bool multipleAdvectionSteps = false;
+    size_t counter = 0;
+    psSmartPointer<psPointData<NumericType>> resumedCoverages = nullptr;
+    if (!resumeFileName.empty()) {
+      if (!readCheckpoint(resumeFileName, remainingTime, previousTimeStep,
+                          counter, resumedCoverages))
+        return;
+      resumeFileName.clear();
+    }
+
     psUtils::Timer processTimer;
     processTimer.start();
+    profile.clear();
+
+    // intermediate output is written in the background
+    outputWriter = psSmartPointer<psAsyncVTKWriter<NumericType>>::New();
 
-    double remainingTime = processDuration;
     assert(domain->getLevelSets()->size() != 0 && "No level sets in domain.");
     const NumericType gridDelta =
         domain->getLevelSets()->back()->getGrid().getGridDelta();
@@ -236,9 +380,19 @@ public:
       meshConverter.setMaterialMap(domain->getMaterialMap()->getMaterialMap());
     }
 
-    auto transField = psSmartPointer<psTranslationField<NumericType>>::New(
-        model->getVelocityField(), domain->getMaterialMap());
-    transField->setTranslator(translator);
+    // The translator generated by the disk mesh conversion is converted into
+    // a dense vector once per conversion, since it is queried for every level
+    // set point during advection.
+    auto denseTranslator = lsSmartPointer<denseTranslatorType>::New();
+    auto convertDiskMesh = [&]() {
+      meshConverter.apply();
+      psTranslationField<NumericType>::toDenseTranslator(
+          *translator, domain->getLevelSets()->back()->getNumberOfPoints(),
+          *denseTranslator);
+    };
+
+    auto transField = model->createTranslationField(domain->getMaterialMap());
+    transField->setTranslator(denseTranslator);
 
     lsAdvect<NumericType, D> advectionKernel;
     advectionKernel.setVelocityField(transField);
@@ -256,6 +410,9 @@ public:
     rayBoundaryCondition rayBoundaryCondition[D];
     rayTrace<NumericType, D> rayTracer;
 
+    rayTracingPoints.clear();
+    rayTracingNormals.clear();
+    previousRates = nullptr;
     if (useRayTracing) {
       // Map the domain boundary to the ray tracing boundaries
       for (unsigned i = 0; i < D; ++i)
@@ -305,11 +462,38 @@ public:
 
     bool useCoverages = false;
 
+    // The disk mesh is regenerated after every advection step to update the
+    // coverages. Unless an advection callback had the chance to modify the
+    // level sets afterwards, this mesh is still valid at the start of the next
+    // step and the conversion does not have to be repeated.
+    bool diskMeshIsCurrent = false;
+    psUtils::Timer meshTimer;
+
     // Initialize coverages
-    meshConverter.apply();
+    meshTimer.start();
+    convertDiskMesh();
+    meshTimer.finish();
+    diskMeshIsCurrent = true;
     auto numPoints = diskMesh->getNodes().size();
-    if (!coveragesInitialized)
+    if (!coveragesInitialized || resumedCoverages)
       model->getSurfaceModel()->initializeCoverages(numPoints);
+    if (resumedCoverages && model->getSurfaceModel()->getCoverages()) {
+      auto coverages = model->getSurfaceModel()->getCoverages();
+      for (size_t i = 0; i < resumedCoverages->getScalarDataSize(); i++) {
+        auto resumed = resumedCoverages->getScalarData(i);
+        auto coverage =
+            coverages->getScalarData(resumedCoverages->getScalarDataLabel(i));
+        if (!coverage || resumed->size() != numPoints) {
+          psLogger::getInstance()
+              .addWarning("Coverages in checkpoint do not match the surface. "
+                          "Reinitializing coverages.")
+              .print();
+          coveragesInitialized = false;
+          break;
+        }
+        *coverage = std::move(*resumed);
+      }
+    }
     if (model->getSurfaceModel()->getCoverages() != nullptr) {
       psUtils::Timer timer;
       useCoverages = true;
@@ -317,14 +501,30 @@ public:
       if (!coveragesInitialized) {
         timer.start();
         psLogger::getInstance().addInfo("Initializing coverages ... ").print();
-        auto points = diskMesh->getNodes();
-        auto normals = *diskMesh->getCellData().getVectorData("Normals");
-        auto materialIds =
+        // References into the disk mesh. The intermediate output adds data to
+        // the mesh, so the material IDs are looked up again in each iteration.
+        auto &points = diskMesh->getNodes();
+        auto &normals = *diskMesh->getCellData().getVectorData("Normals");
+        auto &materialIds =
             *diskMesh->getCellData().getScalarData("MaterialIds");
         rayTracer.setGeometry(points, normals, gridDelta);
         rayTracer.setMaterialIds(materialIds);
+        rayTracingPoints = points;
+        rayTracingNormals = normals;
+
+        std::size_t geometryKey = 0, parameterKey = 0;
+        bool cacheHit = false;
+        if (coverageCache) {
+          geometryKey = psCoverageCache<NumericType>::hashGeometry(
+              points, materialIds, gridDelta);
+          parameterKey = coverageParameterKey();
+          cacheHit = seedCoveragesFromCache(geometryKey, parameterKey, points,
+                                            gridDelta);
+        }
 
-        for (size_t iterations = 0; iterations < maxIterations; iterations++) {
+        coverageResiduals.clear();
+        size_t iterations = 0;
+        for (; iterations < maxIterations && !cacheHit; iterations++) {
           // We need additional signal handling when running the C++ code from
           // the
           // Python bindings to allow interrupts in the Python scripts
@@ -335,56 +535,21 @@ public:
           // move coverages to the ray tracer
           rayTracingData<NumericType> rayTraceCoverages =
               movePointDataToRayData(model->getSurfaceModel()->getCoverages());
-          if (useProcessParams) {
-            // store scalars in addition to coverages
-            auto processParams =
-                model->getSurfaceModel()->getProcessParameters();
-            NumericType numParams = processParams->getScalarData().size();
-            rayTraceCoverages.setNumberOfScalarData(numParams);
-            for (size_t i = 0; i < numParams; ++i) {
-              rayTraceCoverages.setScalarData(
-                  i, processParams->getScalarData(i),
-                  processParams->getScalarDataLabel(i));
-            }
-          }
+          if (useProcessParams)
+            addProcessParamsToRayData(rayTraceCoverages);
           rayTracer.setGlobalData(rayTraceCoverages);
 
           auto rates = psSmartPointer<psPointData<NumericType>>::New();
-
-          std::size_t particleIdx = 0;
-          for (auto &particle : *model->getParticleTypes()) {
-            int dataLogSize = model->getParticleLogSize(particleIdx);
-            if (dataLogSize > 0) {
-              rayTracer.getDataLog().data.resize(1);
-              rayTracer.getDataLog().data[0].resize(dataLogSize, 0.);
-            }
-            rayTracer.setParticleType(particle);
-            rayTracer.apply();
-
-            // fill up rates vector with rates from this particle type
-            auto &localData = rayTracer.getLocalData();
-            int numRates = particle->getLocalDataLabels().size();
-            for (int i = 0; i < numRates; ++i) {
-              auto rate = std::move(localData.getVectorData(i));
-
-              // normalize fluxes
-              rayTracer.normalizeFlux(rate);
-              if (smoothFlux)
-                rayTracer.smoothFlux(rate);
-              rates->insertNextScalarData(std::move(rate),
-                                          localData.getVectorDataLabel(i));
-            }
-
-            if (dataLogSize > 0) {
-              particleDataLogs[particleIdx].merge(rayTracer.getDataLog());
-            }
-            ++particleIdx;
-          }
+          calculateRates(rayTracer, rates);
 
           // move coverages back in the model
           moveRayDataToPointData(model->getSurfaceModel()->getCoverages(),
                                  rayTraceCoverages);
-          model->getSurfaceModel()->updateCoverages(rates, materialIds);
+          storePreviousCoverages(*model->getSurfaceModel()->getCoverages());
+          model->getSurfaceModel()->updateCoverages(
+              rates, *diskMesh->getCellData().getScalarData("MaterialIds"));
+          coverageResiduals.push_back(
+              coverageResidual(*model->getSurfaceModel()->getCoverages()));
 
           if (psLogger::getLogLevel() >= 3) {
             auto coverages = model->getSurfaceModel()->getCoverages();
@@ -404,25 +569,64 @@ public:
                 .addInfo("Iteration: " + std::to_string(iterations))
                 .print();
           }
+
+          if (coverageResiduals.back() < coverageConvergenceTolerance) {
+            iterations++;
+            break;
+          }
         }
         coveragesInitialized = true;
+        if (coverageCache && !cacheHit)
+          coverageCache->insert(geometryKey, parameterKey, points,
+                                *model->getSurfaceModel()->getCoverages());
+        psLogger::getInstance()
+            .addInfo("Coverage initialization finished after " +
+                     std::to_string(iterations) + " iterations with residual " +
+                     std::to_string(coverageResiduals.empty()
+                                        ? 0.
+                                        : coverageResiduals.back()))
+            .print();
+        // intermediate output added data to the disk mesh
+        if (psLogger::getLogLevel() >= 3)
+          diskMeshIsCurrent = false;
 
         timer.finish();
+        profile.coverageInitialization = timer.currentDuration * 1e-9;
+        profile.coverageInitializationIterations = iterations;
         psLogger::getInstance()
             .addTiming("Coverage initialization", timer)
             .print();
       }
     } // end coverage initialization
 
-    double previousTimeStep = 0.;
-    size_t counter = 0;
+    size_t step = 0;
+    const bool reuseFluxes = fluxUpdateSteps > 1;
+    unsigned stepsSinceFluxUpdate = 0;
+    NumericType displacementSinceFluxUpdate = 0.;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
     psUtils::Timer rtTimer;
+    psUtils::Timer geometryTimer;
     psUtils::Timer callbackTimer;
     psUtils::Timer advTimer;
+    psUtils::Timer stepTimer;
+    psUtils::Timer velocityTimer;
+    // adds the profile of the current step, also if a callback stops the
+    // process during the step
+    auto recordStepProfile = [&](const NumericType timeStep) {
+      stepTimer.finish();
+      stepProfile.timeStep = timeStep;
+      stepProfile.total = stepTimer.currentDuration * 1e-9;
+      profile.steps.push_back(std::move(stepProfile));
+    };
     while (remainingTime > 0.) {
       psLogger::getInstance()
           .addInfo("Remaining time: " + std::to_string(remainingTime))
           .print();
+      stepTimer.start();
+      stepProfile = psProcessStepProfile();
+      stepProfile.processTime = processDuration - remainingTime;
+      if (useRayTracing)
+        stepProfile.particles.resize(model->getParticleTypes()->size());
 
       // We need additional signal handling when running the C++ code from the
       // Python bindings to allow interrupts in the Python scripts
@@ -432,113 +636,111 @@ public:
 #endif
 
       auto rates = psSmartPointer<psPointData<NumericType>>::New();
-      meshConverter.apply();
-      auto materialIds = *diskMesh->getCellData().getScalarData("MaterialIds");
-      auto points = diskMesh->getNodes();
-
-      // rate calculation by top-down ray tracing
-      if (useRayTracing) {
+      if (!diskMeshIsCurrent) {
+        meshTimer.start();
+        convertDiskMesh();
+        meshTimer.finish();
+        stepProfile.diskMeshConversion += meshTimer.currentDuration * 1e-9;
+        psLogger::getInstance()
+            .addTiming("Disk mesh conversion", meshTimer)
+            .print();
+      }
+      // References into the disk mesh, which are valid until data is added to
+      // the mesh or it is regenerated after advection.
+      auto &materialIds = *diskMesh->getCellData().getScalarData("MaterialIds");
+      auto &points = diskMesh->getNodes();
+      stepProfile.numSurfacePoints = points.size();
+
+      // rate calculation by top-down ray tracing, unless the rates of the last
+      // flux calculation can be reused
+      const bool updateFluxes =
+          !reuseFluxes || !previousRates ||
+          stepsSinceFluxUpdate >= fluxUpdateSteps ||
+          (fluxUpdateDisplacement > 0. &&
+           displacementSinceFluxUpdate > fluxUpdateDisplacement * gridDelta);
+      if (useRayTracing && !updateFluxes) {
+        rates = mapPointData(previousRatePoints, previousRates, points);
+        psLogger::getInstance()
+            .addInfo("Reusing fluxes from " +
+                     std::to_string(stepsSinceFluxUpdate) + " steps ago.")
+            .print();
+      } else if (useRayTracing) {
         rtTimer.start();
-        auto normals = *diskMesh->getCellData().getVectorData("Normals");
-        rayTracer.setGeometry(points, normals, gridDelta);
+        geometryTimer.start();
+        auto &normals = *diskMesh->getCellData().getVectorData("Normals");
+        if (!rayTracingGeometryIsValid(points, normals, gridDelta)) {
+          rayTracer.setGeometry(points, normals, gridDelta);
+          rayTracingPoints = points;
+          rayTracingNormals = normals;
+        } else {
+          psLogger::getInstance()
+              .addInfo("Reusing ray tracing geometry.")
+              .print();
+        }
         rayTracer.setMaterialIds(materialIds);
+        geometryTimer.finish();
+        stepProfile.geometryUpdate = geometryTimer.currentDuration * 1e-9;
+        psLogger::getInstance()
+            .addTiming("Ray tracing geometry update", geometryTimer)
+            .print();
 
         // move coverages to ray tracer
         rayTracingData<NumericType> rayTraceCoverages;
         if (useCoverages) {
           rayTraceCoverages =
               movePointDataToRayData(model->getSurfaceModel()->getCoverages());
-          if (useProcessParams) {
-            // store scalars in addition to coverages
-            auto processParams =
-                model->getSurfaceModel()->getProcessParameters();
-            NumericType numParams = processParams->getScalarData().size();
-            rayTraceCoverages.setNumberOfScalarData(numParams);
-            for (size_t i = 0; i < numParams; ++i) {
-              rayTraceCoverages.setScalarData(
-                  i, processParams->getScalarData(i),
-                  processParams->getScalarDataLabel(i));
-            }
-          }
+          if (useProcessParams)
+            addProcessParamsToRayData(rayTraceCoverages);
           rayTracer.setGlobalData(rayTraceCoverages);
         }
 
-        std::size_t particleIdx = 0;
-        for (auto &particle : *model->getParticleTypes()) {
-          int dataLogSize = model->getParticleLogSize(particleIdx);
-          if (dataLogSize > 0) {
-            rayTracer.getDataLog().data.resize(1);
-            rayTracer.getDataLog().data[0].resize(dataLogSize, 0.);
-          }
-          rayTracer.setParticleType(particle);
-          rayTracer.apply();
-
-          // fill up rates vector with rates from this particle type
-          auto numRates = particle->getLocalDataLabels().size();
-          auto &localData = rayTracer.getLocalData();
-          for (int i = 0; i < numRates; ++i) {
-            auto rate = std::move(localData.getVectorData(i));
-
-            // normalize rates
-            rayTracer.normalizeFlux(rate);
-            if (smoothFlux)
-              rayTracer.smoothFlux(rate);
-            rates->insertNextScalarData(std::move(rate),
-                                        localData.getVectorDataLabel(i));
-          }
-
-          if (dataLogSize > 0) {
-            particleDataLogs[particleIdx].merge(rayTracer.getDataLog());
-          }
-          ++particleIdx;
+        calculateRates(rayTracer, rates);
+        if (fluxBlendingFactor < 1. || reuseFluxes) {
+          if (fluxBlendingFactor < 1.)
+            blendWithPreviousRates(rates, points);
+          previousRates = psSmartPointer<psPointData<NumericType>>::New(*rates);
+          previousRatePoints = points;
         }
+        stepsSinceFluxUpdate = 0;
+        displacementSinceFluxUpdate = 0.;
 
         // move coverages back to model
         if (useCoverages)
           moveRayDataToPointData(model->getSurfaceModel()->getCoverages(),
                                  rayTraceCoverages);
         rtTimer.finish();
+        stepProfile.fluxesTraced = true;
+        stepProfile.fluxCalculation = rtTimer.currentDuration * 1e-9;
         psLogger::getInstance()
             .addTiming("Top-down flux calculation", rtTimer)
             .print();
       }
 
       // get velocities from rates
+      velocityTimer.start();
       auto velocities = model->getSurfaceModel()->calculateVelocities(
           rates, points, materialIds);
       model->getVelocityField()->setVelocities(velocities);
-      if (model->getVelocityField()->getTranslationFieldOptions() == 2)
+      velocityTimer.finish();
+      stepProfile.velocityCalculation = velocityTimer.currentDuration * 1e-9;
+      NumericType maxVelocity = 0.;
+      if (reuseFluxes && velocities) {
+        for (const auto v : *velocities)
+          maxVelocity = std::max(maxVelocity, std::abs(v));
+      }
+
+      if (model->getVelocityField()->getTranslationFieldOptions() == 2) {
+        psUtils::Timer kdTreeTimer;
+        kdTreeTimer.start();
         transField->buildKdTree(points);
+        kdTreeTimer.finish();
+        stepProfile.kdTreeBuild = kdTreeTimer.currentDuration * 1e-9;
+      }
 
       // print debug output
-      if (psLogger::getLogLevel() >= 4) {
-        if (velocities)
-          diskMesh->getCellData().insertNextScalarData(*velocities,
-                                                       "velocities");
-        if (useCoverages) {
-          auto coverages = model->getSurfaceModel()->getCoverages();
-          for (size_t idx = 0; idx < coverages->getScalarDataSize(); idx++) {
-            auto label = coverages->getScalarDataLabel(idx);
-            diskMesh->getCellData().insertNextScalarData(
-                *coverages->getScalarData(idx), label);
-          }
-        }
-        for (size_t idx = 0; idx < rates->getScalarDataSize(); idx++) {
-          auto label = rates->getScalarDataLabel(idx);
-          diskMesh->getCellData().insertNextScalarData(
-              *rates->getScalarData(idx), label);
-        }
-        if (printTime >= 0. &&
-            ((processDuration - remainingTime) - printTime * counter) > 0.) {
-          printDiskMesh(diskMesh,
-                        name + "_" + std::to_string(counter) + ".vtp");
-          if (domain->getCellSet()) {
-            domain->getCellSet()->writeVTU(name + "_cellSet_" +
-                                           std::to_string(counter) + ".vtu");
-          }
-          counter++;
-        }
-      }
+      if (psLogger::getLogLevel() >= 4)
+        printIntermediateOutput(diskMesh, velocities, rates, name,
+                                processDuration - remainingTime, counter);
 
       // apply advection callback
       if (useAdvectionCallback) {
@@ -546,6 +748,7 @@ public:
         bool continueProcess = model->getAdvectionCallback()->applyPreAdvect(
             processDuration - remainingTime);
         callbackTimer.finish();
+        stepProfile.callbacks += callbackTimer.currentDuration * 1e-9;
         psLogger::getInstance()
             .addTiming("Advection callback pre-advect", callbackTimer)
             .print();
@@ -555,6 +758,7 @@ public:
               .addInfo("Process stopped early by AdvectionCallback during "
                        "`preAdvect`.")
               .print();
+          recordStepProfile(0.);
           break;
         }
       }
@@ -562,22 +766,44 @@ public:
       // adjust time step near end
       if (remainingTime - previousTimeStep < 0.) {
         advectionKernel.setAdvectionTime(remainingTime);
+        multipleAdvectionSteps = true;
       }
 
       // move coverages to LS, so they get are moved with the advection step
       if (useCoverages)
-        moveCoveragesToTopLS(translator,
+        moveCoveragesToTopLS(*denseTranslator,
                              model->getSurfaceModel()->getCoverages());
+
+      // resolve the velocities of the narrow band before the advection, which
+      // is only valid if the advection performs a single step
+      if (!multipleAdvectionSteps) {
+        velocityTimer.start();
+        transField->prepareAdvection(domain->getLevelSets()->back());
+        velocityTimer.finish();
+        stepProfile.velocityCalculation += velocityTimer.currentDuration * 1e-9;
+      }
+
       advTimer.start();
       advectionKernel.apply();
       advTimer.finish();
+      transField->clearPreparedAdvection();
+      stepProfile.advection = advTimer.currentDuration * 1e-9;
       psLogger::getInstance().addTiming("Surface advection", advTimer).print();
 
       // update the translator to retrieve the correct coverages from the LS
-      meshConverter.apply();
+      meshTimer.start();
+      convertDiskMesh();
+      meshTimer.finish();
+      stepProfile.diskMeshConversion += meshTimer.currentDuration * 1e-9;
+      psLogger::getInstance()
+          .addTiming("Disk mesh conversion", meshTimer)
+          .print();
+      // the post-advect callback is allowed to change the level sets
+      diskMeshIsCurrent = !useAdvectionCallback;
       if (useCoverages)
         updateCoveragesFromAdvectedSurface(
-            translator, model->getSurfaceModel()->getCoverages());
+            *denseTranslator, diskMesh->getNodes().size(),
+            model->getSurfaceModel()->getCoverages());
 
       // apply advection callback
       if (useAdvectionCallback) {
@@ -585,6 +811,7 @@ public:
         bool continueProcess = model->getAdvectionCallback()->applyPostAdvect(
             advectionKernel.getAdvectedTime());
         callbackTimer.finish();
+        stepProfile.callbacks += callbackTimer.currentDuration * 1e-9;
         psLogger::getInstance()
             .addTiming("Advection callback post-advect", callbackTimer)
             .print();
@@ -593,28 +820,65 @@ public:
               .addInfo("Process stopped early by AdvectionCallback during "
                        "`postAdvect`.")
               .print();
+          recordStepProfile(advectionKernel.getAdvectedTime());
           break;
         }
       }
 
       previousTimeStep = advectionKernel.getAdvectedTime();
       remainingTime -= previousTimeStep;
+      ++step;
+
+      recordStepProfile(previousTimeStep);
+
+      // Upper bound for the distance the surface moved. Without scalar
+      // velocities the CFL condition limits the distance.
+      ++stepsSinceFluxUpdate;
+      displacementSinceFluxUpdate += velocities
+                                         ? previousTimeStep * maxVelocity
+                                         : timeStepRatio * gridDelta;
+
+      if (!checkpointFileName.empty() && remainingTime > 0.) {
+        const std::chrono::duration<double> sinceCheckpoint =
+            std::chrono::steady_clock::now() - lastCheckpoint;
+        if ((checkpointSteps > 0 && step % checkpointSteps == 0) ||
+            (checkpointSeconds > 0. &&
+             sinceCheckpoint.count() >= checkpointSeconds)) {
+          psUtils::Timer checkpointTimer;
+          checkpointTimer.start();
+          writeCheckpoint(checkpointFileName, remainingTime, previousTimeStep,
+                          counter);
+          checkpointTimer.finish();
+          psLogger::getInstance()
+              .addTiming("Checkpoint writing", checkpointTimer)
+              .print();
+          lastCheckpoint = std::chrono::steady_clock::now();
+        }
+      }
     }
 
     processTime = processDuration - remainingTime;
+    outputWriter->flush();
     processTimer.finish();
+    profile.total = processTimer.currentDuration * 1e-9;
 
     psLogger::getInstance()
         .addTiming("\nProcess " + name, processTimer)
         .addTiming("Surface advection total time",
                    advTimer.totalDuration * 1e-9,
                    processTimer.totalDuration * 1e-9)
+        .addTiming("Disk mesh conversion total time",
+                   meshTimer.totalDuration * 1e-9,
+                   processTimer.totalDuration * 1e-9)
         .print();
     if (useRayTracing) {
       psLogger::getInstance()
           .addTiming("Top-down flux calculation total time",
                      rtTimer.totalDuration * 1e-9,
                      processTimer.totalDuration * 1e-9)
+          .addTiming("Ray tracing geometry update total time",
+                     geometryTimer.totalDuration * 1e-9,
+                     processTimer.totalDuration * 1e-9)
           .print();
     }
     if (useAdvectionCallback) {
@@ -650,9 +914,44 @@ private:
     psVTKWriter<NumericType>(mesh, name).apply();
   }
 
+  // Adds the velocities, coverages and rates to the disk mesh and writes it,
+  // together with the cell set, if the print time interval has passed.
+  void printIntermediateOutput(
+      lsSmartPointer<lsMesh<NumericType>> diskMesh,
+      psSmartPointer<std::vector<NumericType>> velocities,
+      psSmartPointer<psPointData<NumericType>> rates, const std::string &name,
+      const double elapsedTime, size_t &counter) {
+    if (velocities)
+      diskMesh->getCellData().insertNextScalarData(*velocities, "velocities");
+    if (auto coverages = model->getSurfaceModel()->getCoverages()) {
+      for (size_t idx = 0; idx < coverages->getScalarDataSize(); idx++) {
+        auto label = coverages->getScalarDataLabel(idx);
+        diskMesh->getCellData().insertNextScalarData(
+            *coverages->getScalarData(idx), label);
+      }
+    }
+    for (size_t idx = 0; idx < rates->getScalarDataSize(); idx++) {
+      auto label = rates->getScalarDataLabel(idx);
+      diskMesh->getCellData().insertNextScalarData(*rates->getScalarData(idx),
+                                                   label);
+    }
+    if (printTime >= 0. && (elapsedTime - printTime * counter) > 0.) {
+      printDiskMesh(diskMesh, name + "_" + std::to_string(counter) + ".vtp");
+      if (domain->getCellSet()) {
+        outputWriter->write(domain->getCellSet()->getCellMesh(),
+                            name + "_cellSet_" + std::to_string(counter) +
+                                ".vtu");
+      }
+      counter++;
+    }
+  }
+
+  // Writes a copy of the mesh in the background, since the disk mesh is
+  // modified in the next time step.
   void printDiskMesh(lsSmartPointer<lsMesh<NumericType>> mesh,
                      std::string name) {
-    psVTKWriter<NumericType>(mesh, name).apply();
+    outputWriter->write(lsSmartPointer<lsMesh<NumericType>>::New(*mesh),
+                        std::move(name));
   }
 
   rayBoundaryCondition convertBoundaryCondition(
@@ -676,15 +975,496 @@ private:
     return rayBoundaryCondition::IGNORE;
   }
 
+  // Traces all particle types of the model on the geometry currently set in
+  // the ray tracer and inserts the normalized rates into the passed point
+  // data. Rates are stored in the order of the particle types.
+  void calculateRates(rayTrace<NumericType, D> &rayTracer,
+                      psSmartPointer<psPointData<NumericType>> rates) {
+    psUtils::Timer postProcessingTimer;
+    std::size_t particleIdx = 0;
+    for (auto &particle : *model->getParticleTypes()) {
+      rayTracer.setParticleType(particle);
+      rayTracer.setNumberOfRaysPerPoint(raysPerPoint);
+      traceParticle(rayTracer, particleIdx);
+
+      // fill up rates vector with rates from this particle type
+      auto &localData = rayTracer.getLocalData();
+      const auto numRates = particle->getLocalDataLabels().size();
+      std::vector<std::vector<NumericType>> particleRates(numRates);
+      std::vector<std::string> labels(numRates);
+      for (std::size_t i = 0; i < numRates; ++i) {
+        particleRates[i] = std::move(localData.getVectorData(i));
+        labels[i] = localData.getVectorDataLabel(i);
+
+        // normalize rates
+        postProcessingTimer.start();
+        rayTracer.normalizeFlux(particleRates[i]);
+        postProcessingTimer.finish();
+      }
+
+      if (useAdaptiveRays)
+        refineRates(rayTracer, particleIdx, particleRates);
+
+      for (std::size_t i = 0; i < numRates; ++i) {
+        rates->insertNextScalarData(std::move(particleRates[i]), labels[i]);
+      }
+      ++particleIdx;
+    }
+
+    // Smoothing only depends on the geometry, so the rates of all particle
+    // types are smoothed together once tracing is finished.
+    if (smoothFlux) {
+      postProcessingTimer.start();
+      for (std::size_t i = 0; i < rates->getScalarDataSize(); ++i)
+        rayTracer.smoothFlux(*rates->getScalarData(i));
+      postProcessingTimer.finish();
+    }
+    stepProfile.fluxPostProcessing += postProcessingTimer.totalDuration * 1e-9;
+  }
+
+  // Maps the scalar data given on the source points to the target points by
+  // assigning the value of the nearest source point.
+  static psSmartPointer<psPointData<NumericType>>
+  mapPointData(const std::vector<std::array<NumericType, 3>> &sourcePoints,
+               psSmartPointer<psPointData<NumericType>> sourceData,
+               const std::vector<std::array<NumericType, 3>> &targetPoints) {
+    psKDTree<NumericType, std::array<NumericType, 3>> kdTree(sourcePoints);
+    kdTree.build();
+
+    const long numTargetPoints = targetPoints.size();
+    std::vector<std::size_t> nearestIds(numTargetPoints);
+#pragma omp parallel for
+    for (long i = 0; i < numTargetPoints; ++i) {
+      nearestIds[i] = kdTree.findNearest(targetPoints[i])->first;
+    }
+
+    auto targetData = psSmartPointer<psPointData<NumericType>>::New();
+    for (std::size_t i = 0; i < sourceData->getScalarDataSize(); ++i) {
+      const auto &source = *sourceData->getScalarData(i);
+      std::vector<NumericType> target(numTargetPoints);
+      for (long j = 0; j < numTargetPoints; ++j) {
+        target[j] = source[nearestIds[j]];
+      }
+      targetData->insertNextScalarData(std::move(target),
+                                       sourceData->getScalarDataLabel(i));
+    }
+    return targetData;
+  }
+
+  // Blends the rates with the rates of the previous time step, which are first
+  // mapped onto the current surface points.
+  void blendWithPreviousRates(
+      psSmartPointer<psPointData<NumericType>> rates,
+      const std::vector<std::array<NumericType, 3>> &points) {
+    if (previousRates &&
+        previousRates->getScalarDataSize() == rates->getScalarDataSize()) {
+      auto mappedRates =
+          mapPointData(previousRatePoints, previousRates, points);
+      for (std::size_t i = 0; i < rates->getScalarDataSize(); ++i) {
+        auto &rate = *rates->getScalarData(i);
+        const auto &previousRate = *mappedRates->getScalarData(i);
+        for (std::size_t j = 0; j < rate.size(); ++j) {
+          rate[j] = fluxBlendingFactor * rate[j] +
+                    (1. - fluxBlendingFactor) * previousRate[j];
+        }
+      }
+    }
+  }
+
+  // Runs the ray tracer for the particle type that is currently set and
+  // merges the particle data log.
+  void traceParticle(rayTrace<NumericType, D> &rayTracer,
+                     const std::size_t particleIdx) {
+    int dataLogSize = model->getParticleLogSize(particleIdx);
+    if (dataLogSize > 0) {
+      rayTracer.getDataLog().data.resize(1);
+      rayTracer.getDataLog().data[0].resize(dataLogSize, 0.);
+    }
+    psUtils::Timer traceTimer;
+    traceTimer.start();
+    rayTracer.apply();
+    traceTimer.finish();
+    if (dataLogSize > 0) {
+      particleDataLogs[particleIdx].merge(rayTracer.getDataLog());
+    }
+
+    if (particleIdx < stepProfile.particles.size()) {
+      auto &particleProfile = stepProfile.particles[particleIdx];
+      const auto info = rayTracer.getRayTraceInfo();
+      particleProfile.traceTime += traceTimer.currentDuration * 1e-9;
+      particleProfile.raysTraced += info.numRays;
+      particleProfile.reflections += info.totalRaysTraced - info.numRays;
+      particleProfile.diskHits += info.totalDiskHits;
+      particleProfile.geometryHits += info.geometryHits;
+      particleProfile.nonGeometryHits += info.nonGeometryHits;
+    }
+  }
+
+  // Traces additional rays for the current particle type until the relative
+  // error of the flux reaches the target or the maximum number of rays per
+  // point is used up. The results of all passes are averaged, weighted by the
+  // number of rays of each pass.
+  void refineRates(rayTrace<NumericType, D> &rayTracer,
+                   const std::size_t particleIdx,
+                   std::vector<std::vector<NumericType>> &particleRates) {
+    psUtils::Timer postProcessingTimer;
+    auto relativeError = estimateRelativeError(rayTracer.getRelativeError());
+    unsigned tracedRays = raysPerPoint;
+
+    while (relativeError > targetRelativeError &&
+           tracedRays < maxRaysPerPoint) {
+      // The relative error decreases with the square root of the number of
+      // rays, which gives an estimate of the rays still needed.
+      const NumericType ratio = relativeError / targetRelativeError;
+      const auto requiredRays =
+          static_cast<unsigned>(std::ceil(tracedRays * ratio * ratio));
+      const unsigned additionalRays =
+          std::max(1u, std::min(requiredRays, maxRaysPerPoint) - tracedRays);
+
+      psLogger::getInstance()
+          .addDebug("Relative error " + std::to_string(relativeError) +
+                    ", tracing " + std::to_string(additionalRays) +
+                    " additional rays per point.")
+          .print();
+
+      rayTracer.setNumberOfRaysPerPoint(additionalRays);
+      traceParticle(rayTracer, particleIdx);
+
+      auto &localData = rayTracer.getLocalData();
+      const NumericType totalRays = tracedRays + additionalRays;
+      const NumericType oldWeight = tracedRays / totalRays;
+      const NumericType newWeight = additionalRays / totalRays;
+      for (std::size_t i = 0; i < particleRates.size(); ++i) {
+        auto &rate = localData.getVectorData(i);
+        postProcessingTimer.start();
+        rayTracer.normalizeFlux(rate);
+        postProcessingTimer.finish();
+        auto &combinedRate = particleRates[i];
+#pragma omp parallel for
+        for (long j = 0; j < static_cast<long>(rate.size()); ++j) {
+          combinedRate[j] = oldWeight * combinedRate[j] + newWeight * rate[j];
+        }
+      }
+
+      // error of the combined estimate, assuming independent passes
+      relativeError = estimateRelativeError(rayTracer.getRelativeError()) *
+                      std::sqrt(newWeight);
+      tracedRays += additionalRays;
+    }
+    stepProfile.fluxPostProcessing += postProcessingTimer.totalDuration * 1e-9;
+
+    psLogger::getInstance()
+        .addInfo("Particle " + std::to_string(particleIdx) + " traced with " +
+                 std::to_string(tracedRays) +
+                 " rays per point, relative error: " +
+                 std::to_string(relativeError))
+        .print();
+  }
+
+  // Returns the relative error that 95 % of the surface points which were hit
+  // at least once stay below. Points that were never hit (relative error of 1)
+  // are usually shadowed and would otherwise prevent convergence.
+  static NumericType
+  estimateRelativeError(std::vector<NumericType> relativeError) {
+    auto end = std::remove_if(relativeError.begin(), relativeError.end(),
+                              [](const NumericType e) { return e >= 1.; });
+    const auto numHit = std::distance(relativeError.begin(), end);
+    if (numHit == 0)
+      return 0.;
+
+    auto quantile = relativeError.begin() + (numHit * 95) / 100;
+    if (quantile == end)
+      --quantile;
+    std::nth_element(relativeError.begin(), quantile, end);
+    return *quantile;
+  }
+
+  // Store the process parameters as scalar data in addition to the coverages.
+  void addProcessParamsToRayData(rayTracingData<NumericType> &rayData) {
+    auto processParams = model->getSurfaceModel()->getProcessParameters();
+    const auto numParams = processParams->getScalarData().size();
+    rayData.setNumberOfScalarData(numParams);
+    for (std::size_t i = 0; i < numParams; ++i) {
+      rayData.setScalarData(i, processParams->getScalarData(i),
+                            processParams->getScalarDataLabel(i));
+    }
+  }
+
+  // Writes the domain and the process state to a binary checkpoint file. The
+  // file is first written to a temporary file and then renamed, so an
+  // interrupted write does not destroy the previous checkpoint.
+  void writeCheckpoint(const std::string &fileName, double remainingTime,
+                       double previousTimeStep, size_t counter) const {
+    const std::string tmpFileName = fileName + ".tmp";
+    std::ofstream file(tmpFileName, std::ios::binary);
+    if (!file.is_open()) {
+      psLogger::getInstance()
+          .addWarning("Could not open checkpoint file " + tmpFileName)
+          .print();
+      return;
+    }
+
+    psUtils::writeBinary(file, std::string(checkpointIdentifier));
+    psUtils::writeBinary(file, checkpointVersion);
+    psUtils::writeBinary(file, D);
+    psUtils::writeBinary(file, static_cast<std::uint32_t>(sizeof(NumericType)));
+
+    psUtils::writeBinary(file, static_cast<double>(processDuration));
+    psUtils::writeBinary(file, remainingTime);
+    psUtils::writeBinary(file, previousTimeStep);
+    psUtils::writeBinary(file, static_cast<std::uint64_t>(counter));
+    psUtils::writeBinary(file, static_cast<char>(coveragesInitialized));
+
+    auto coverages = model->getSurfaceModel()->getCoverages();
+    const std::uint64_t numCoverages =
+        coverages ? coverages->getScalarDataSize() : 0;
+    psUtils::writeBinary(file, numCoverages);
+    for (std::uint64_t i = 0; i < numCoverages; i++) {
+      psUtils::writeBinary(file, coverages->getScalarDataLabel(i));
+      psUtils::writeBinary(file, *coverages->getScalarData(i));
+    }
+
+    psUtils::writeBinary(file,
+                         static_cast<std::uint64_t>(particleDataLogs.size()));
+    for (const auto &dataLog : particleDataLogs) {
+      psUtils::writeBinary(file,
+                           static_cast<std::uint64_t>(dataLog.data.size()));
+      for (const auto &data : dataLog.data)
+        psUtils::writeBinary(file, data);
+    }
+
+    domain->serialize(file);
+    file.close();
+
+    if (!file) {
+      psLogger::getInstance()
+          .addWarning("Failed to write checkpoint file " + tmpFileName)
+          .print();
+      return;
+    }
+
+    std::remove(fileName.c_str());
+    if (std::rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+      psLogger::getInstance()
+          .addWarning("Could not move checkpoint to " + fileName)
+          .print();
+    }
+  }
+
+  // Reads a checkpoint file written by writeCheckpoint. The domain, the
+  // particle data logs and the coverage initialization state are restored
+  // directly; the remaining process state is returned.
+  bool readCheckpoint(const std::string &fileName, double &remainingTime,
+                      double &previousTimeStep, size_t &counter,
+                      psSmartPointer<psPointData<NumericType>> &coverages) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+      psLogger::getInstance()
+          .addWarning("Could not open checkpoint file " + fileName)
+          .print();
+      return false;
+    }
+
+    std::string identifier;
+    std::uint32_t version = 0, numericSize = 0;
+    int dimension = 0;
+    psUtils::readBinary(file, identifier);
+    psUtils::readBinary(file, version);
+    psUtils::readBinary(file, dimension);
+    psUtils::readBinary(file, numericSize);
+    if (!file || identifier != checkpointIdentifier ||
+        version != checkpointVersion || dimension != D ||
+        numericSize != sizeof(NumericType)) {
+      psLogger::getInstance()
+          .addWarning("Incompatible checkpoint file " + fileName)
+          .print();
+      return false;
+    }
+
+    double duration = 0.;
+    std::uint64_t printCounter = 0;
+    char covInitialized = 0;
+    psUtils::readBinary(file, duration);
+    psUtils::readBinary(file, remainingTime);
+    psUtils::readBinary(file, previousTimeStep);
+    psUtils::readBinary(file, printCounter);
+    psUtils::readBinary(file, covInitialized);
+
+    std::uint64_t numCoverages = 0;
+    psUtils::readBinary(file, numCoverages);
+    auto readCoverages = psSmartPointer<psPointData<NumericType>>::New();
+    for (std::uint64_t i = 0; i < numCoverages && file; i++) {
+      std::string label;
+      std::vector<NumericType> data;
+      psUtils::readBinary(file, label);
+      psUtils::readBinary(file, data);
+      readCoverages->insertNextScalarData(std::move(data), label);
+    }
+
+    std::uint64_t numDataLogs = 0;
+    psUtils::readBinary(file, numDataLogs);
+    std::vector<rayDataLog<NumericType>> dataLogs(numDataLogs);
+    for (auto &dataLog : dataLogs) {
+      std::uint64_t numData = 0;
+      psUtils::readBinary(file, numData);
+      dataLog.data.resize(numData);
+      for (auto &data : dataLog.data)
+        psUtils::readBinary(file, data);
+    }
+
+    domain->deserialize(file);
+    if (!file) {
+      psLogger::getInstance()
+          .addWarning("Failed to read checkpoint file " + fileName)
+          .print();
+      return false;
+    }
+
+    processDuration = duration;
+    counter = printCounter;
+    coveragesInitialized = covInitialized;
+    coverages = coveragesInitialized && numCoverages > 0 ? readCoverages
+                                                         : nullptr;
+    particleDataLogs = std::move(dataLogs);
+
+    psLogger::getInstance()
+        .addInfo("Resuming process from checkpoint " + fileName +
+                 " with remaining time " + std::to_string(remainingTime))
+        .print();
+    return true;
+  }
+
+  // Combines the user supplied parameter key with the process name and the
+  // process parameters of the surface model.
+  std::size_t coverageParameterKey() const {
+    std::size_t key = coverageCacheKey.value_or(0);
+    psCoverageCache<NumericType>::hashCombine(key,
+                                              coverageCacheKey.has_value());
+    psCoverageCache<NumericType>::hashCombine(
+        key, model->getProcessName().value_or("default"));
+    if (auto params = model->getSurfaceModel()->getProcessParameters()) {
+      for (const auto value : params->getScalarData())
+        psCoverageCache<NumericType>::hashCombine(key, value);
+    }
+    return key;
+  }
+
+  // Sets the coverages of the surface model from the best matching entry in
+  // the coverage cache on the same or a close geometry. Returns true if the
+  // entry was computed for the same geometry and an explicit parameter key,
+  // so no further initialization is required.
+  bool seedCoveragesFromCache(
+      std::size_t geometryKey, std::size_t parameterKey,
+      const std::vector<std::array<NumericType, 3>> &points,
+      const NumericType maxDistance) {
+    typename psCoverageCache<NumericType>::Entry entry;
+    if (!coverageCache->find(geometryKey, parameterKey, points, maxDistance,
+                             entry))
+      return false;
+
+    const bool sameGeometry = entry.geometryKey == geometryKey &&
+                              entry.points.size() == points.size();
+    auto cached = sameGeometry
+                      ? entry.coverages
+                      : mapPointData(entry.points, entry.coverages, points);
+
+    auto coverages = model->getSurfaceModel()->getCoverages();
+    bool seededAll = true;
+    for (size_t i = 0; i < coverages->getScalarDataSize(); i++) {
+      auto coverage = coverages->getScalarData(i);
+      auto cachedCoverage =
+          cached->getScalarData(coverages->getScalarDataLabel(i));
+      if (cachedCoverage && cachedCoverage->size() == coverage->size()) {
+        *coverage = *cachedCoverage;
+      } else {
+        seededAll = false;
+      }
+    }
+
+    psLogger::getInstance()
+        .addInfo(sameGeometry ? "Seeding coverages from cache."
+                              : "Seeding coverages from cache with mapped "
+                                "geometry.")
+        .print();
+    return coverageCacheKey.has_value() && seededAll && sameGeometry &&
+           entry.parameterKey == parameterKey;
+  }
+
+  // Copies the coverages into a buffer which is reused in every iteration of
+  // the coverage initialization.
+  void storePreviousCoverages(const psPointData<NumericType> &coverages) {
+    previousCoverages.resize(coverages.getScalarDataSize());
+    for (size_t i = 0; i < previousCoverages.size(); i++) {
+      const auto &data = *coverages.getScalarData(i);
+      previousCoverages[i].assign(data.begin(), data.end());
+    }
+  }
+
+  // Change of the coverages since they were stored in the buffer.
+  NumericType coverageResidual(const psPointData<NumericType> &current) const {
+    if (current.getScalarDataSize() != previousCoverages.size())
+      return std::numeric_limits<NumericType>::max();
+
+    NumericType residual = 0.;
+    std::size_t numValues = 0;
+    for (size_t i = 0; i < previousCoverages.size(); i++) {
+      const auto &prev = previousCoverages[i];
+      const auto &curr = *current.getScalarData(i);
+      if (curr.size() != prev.size())
+        return std::numeric_limits<NumericType>::max();
+      for (size_t j = 0; j < prev.size(); j++) {
+        const NumericType diff = std::abs(curr[j] - prev[j]);
+        if (coverageResidualNorm == psCoverageResidualNorm::L2)
+          residual += diff * diff;
+        else
+          residual = std::max(residual, diff);
+      }
+      numValues += prev.size();
+    }
+    if (coverageResidualNorm == psCoverageResidualNorm::L2 && numValues > 0)
+      residual = std::sqrt(residual / numValues);
+    return residual;
+  }
+
+  // Checks whether the geometry currently set in the ray tracer can be used
+  // for the passed surface points.
+  bool rayTracingGeometryIsValid(
+      const std::vector<std::array<NumericType, 3>> &points,
+      const std::vector<std::array<NumericType, 3>> &normals,
+      const NumericType gridDelta) const {
+    if (rayTracingPoints.empty() || rayTracingPoints.size() != points.size() ||
+        rayTracingNormals.size() != normals.size())
+      return false;
+
+    const NumericType maxDist = geometryUpdateTolerance * gridDelta;
+    const NumericType maxDistSquared = maxDist * maxDist;
+    const NumericType maxNormalDiffSquared =
+        geometryUpdateTolerance * geometryUpdateTolerance;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      NumericType distSquared = 0.;
+      NumericType normalDiffSquared = 0.;
+      for (unsigned j = 0; j < 3; ++j) {
+        const NumericType diff = points[i][j] - rayTracingPoints[i][j];
+        distSquared += diff * diff;
+        const NumericType normalDiff = normals[i][j] - rayTracingNormals[i][j];
+        normalDiffSquared += normalDiff * normalDiff;
+      }
+      if (distSquared > maxDistSquared ||
+          normalDiffSquared > maxNormalDiffSquared)
+        return false;
+    }
+
+    return true;
+  }
+
   rayTracingData<NumericType>
   movePointDataToRayData(psSmartPointer<psPointData<NumericType>> pointData) {
     rayTracingData<NumericType> rayData;
     const auto numData = pointData->getScalarDataSize();
     rayData.setNumberOfVectorData(numData);
     for (size_t i = 0; i < numData; ++i) {
-      auto label = pointData->getScalarDataLabel(i);
-      rayData.setVectorData(i, std::move(*pointData->getScalarData(label)),
-                            label);
+      rayData.setVectorData(i, std::move(*pointData->getScalarData(i)),
+                            pointData->getScalarDataLabel(i));
     }
 
     return std::move(rayData);
@@ -701,48 +1481,57 @@ private:
   }
 
   void
-  moveCoveragesToTopLS(lsSmartPointer<translatorType> translator,
+  moveCoveragesToTopLS(const denseTranslatorType &translator,
                        psSmartPointer<psPointData<NumericType>> coverages) {
     auto topLS = domain->getLevelSets()->back();
+    auto &pointData = topLS->getPointData();
     for (size_t i = 0; i < coverages->getScalarDataSize(); i++) {
       auto covName = coverages->getScalarDataLabel(i);
-      std::vector<NumericType> levelSetData(topLS->getNumberOfPoints(), 0);
-      auto cov = coverages->getScalarData(covName);
-      for (const auto iter : *translator.get()) {
-        levelSetData[iter.first] = cov->at(iter.second);
+      // reuse the level set data from the previous step if it still exists
+      auto levelSetData = pointData.getScalarData(covName);
+      if (levelSetData == nullptr) {
+        pointData.insertNextScalarData(std::vector<NumericType>(), covName);
+        levelSetData = pointData.getScalarData(covName);
       }
-      if (auto data = topLS->getPointData().getScalarData(covName);
-          data != nullptr) {
-        *data = std::move(levelSetData);
-      } else {
-        topLS->getPointData().insertNextScalarData(std::move(levelSetData),
-                                                   covName);
+      levelSetData->assign(topLS->getNumberOfPoints(), 0);
+      const auto &cov = *coverages->getScalarData(i);
+      const std::size_t numPoints =
+          std::min(translator.size(), levelSetData->size());
+      for (std::size_t lsId = 0; lsId < numPoints; ++lsId) {
+        if (translator[lsId] != psTranslationField<NumericType>::unmappedId)
+          (*levelSetData)[lsId] = cov[translator[lsId]];
       }
     }
   }
 
-  void addMaterialIdsToTopLS(lsSmartPointer<translatorType> translator,
+  void addMaterialIdsToTopLS(const denseTranslatorType &translator,
                              std::vector<NumericType> *materialIds) {
     auto topLS = domain->getLevelSets()->back();
     std::vector<NumericType> levelSetData(topLS->getNumberOfPoints(), 0);
-    for (const auto iter : *translator.get()) {
-      levelSetData[iter.first] = materialIds->at(iter.second);
+    const std::size_t numPoints =
+        std::min(translator.size(), levelSetData.size());
+    for (std::size_t lsId = 0; lsId < numPoints; ++lsId) {
+      if (translator[lsId] != psTranslationField<NumericType>::unmappedId)
+        levelSetData[lsId] = materialIds->at(translator[lsId]);
     }
     topLS->getPointData().insertNextScalarData(std::move(levelSetData),
                                                "Material");
   }
 
   void updateCoveragesFromAdvectedSurface(
-      lsSmartPointer<translatorType> translator,
+      const denseTranslatorType &translator, std::size_t numSurfacePoints,
       psSmartPointer<psPointData<NumericType>> coverages) {
     auto topLS = domain->getLevelSets()->back();
     for (size_t i = 0; i < coverages->getScalarDataSize(); i++) {
       auto covName = coverages->getScalarDataLabel(i);
-      auto levelSetData = topLS->getPointData().getScalarData(covName);
-      auto covData = coverages->getScalarData(covName);
-      covData->resize(translator->size());
-      for (const auto it : *translator.get()) {
-        covData->at(it.second) = levelSetData->at(it.first);
+      const auto &levelSetData = *topLS->getPointData().getScalarData(covName);
+      auto &covData = *coverages->getScalarData(i);
+      covData.resize(numSurfacePoints);
+      const std::size_t numPoints =
+          std::min(translator.size(), levelSetData.size());
+      for (std::size_t lsId = 0; lsId < numPoints; ++lsId) {
+        if (translator[lsId] != psTranslationField<NumericType>::unmappedId)
+          covData[translator[lsId]] = levelSetData[lsId];
       }
     }
   }
@@ -764,4 +1553,31 @@ private:
   NumericType printTime = 0.;
   NumericType processTime = 0.;
   NumericType timeStepRatio = 0.4999;
+  NumericType geometryUpdateTolerance = 0.;
+  bool useAdaptiveRays = false;
+  NumericType targetRelativeError = 0.05;
+  unsigned maxRaysPerPoint = 10000;
+  NumericType fluxBlendingFactor = 1.;
+  unsigned fluxUpdateSteps = 1;
+  NumericType fluxUpdateDisplacement = 0.;
+  psSmartPointer<psPointData<NumericType>> previousRates = nullptr;
+  std::vector<std::array<NumericType, 3>> previousRatePoints;
+  std::vector<std::array<NumericType, 3>> rayTracingPoints;
+  std::vector<std::array<NumericType, 3>> rayTracingNormals;
+  NumericType coverageConvergenceTolerance = 0.;
+  psCoverageResidualNorm coverageResidualNorm = psCoverageResidualNorm::MAX;
+  std::vector<std::vector<NumericType>> previousCoverages;
+  psSmartPointer<psCoverageCache<NumericType>> coverageCache = nullptr;
+  std::optional<std::size_t> coverageCacheKey;
+  std::vector<NumericType> coverageResiduals;
+  psProcessProfile profile;
+  psProcessStepProfile stepProfile;
+  psSmartPointer<psAsyncVTKWriter<NumericType>> outputWriter = nullptr;
+  std::string checkpointFileName;
+  unsigned checkpointSteps = 0;
+  double checkpointSeconds = 0.;
+  std::string resumeFileName;
+
+  static constexpr char checkpointIdentifier[] = "ViennaPS checkpoint";
+  static constexpr std::uint32_t checkpointVersion = 2;
 };
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <functional>
+#include <type_traits>
+#include <typeinfo>
+
 #include <psAdvectionCallback.hpp>
 #include <psGeometricModel.hpp>
 #include <psSmartPointer.hpp>
 #include <psSurfaceModel.hpp>
+#include <psTranslationField.hpp>
 #include <psVelocityField.hpp>
 
 #include <rayParticle.hpp>
@@ -14,6 +19,7 @@ template <typename NumericType, int D> class psProcessModel {
 protected:
   using ParticleTypeList =
       std::vector<std::unique_ptr<rayAbstractParticle<NumericType>>>;
+  using translationFieldType = psSmartPointer<psTranslationField<NumericType>>;
 
   psSmartPointer<ParticleTypeList> particles = nullptr;
   std::vector<int> particleLogSize;
@@ -22,6 +28,8 @@ protected:
       nullptr;
   psSmartPointer<psGeometricModel<NumericType, D>> geometricModel = nullptr;
   psSmartPointer<psVelocityField<NumericType>> velocityField = nullptr;
+  std::function<translationFieldType(psSmartPointer<psMaterialMap>)>
+      translationFieldFactory = nullptr;
   std::optional<std::string> processName = std::nullopt;
   std::optional<std::array<NumericType, 3>> primaryDirection = std::nullopt;
 
@@ -45,6 +53,18 @@ public:
     return velocityField;
   }
 
+  /// Create the translation field which passes the velocities to the level
+  /// set advection. If the type of the velocity field was known when it was
+  /// set, the velocity functions are called without virtual dispatch.
+  translationFieldType
+  createTranslationField(psSmartPointer<psMaterialMap> materialMap) const {
+    auto field = getVelocityField();
+    if (translationFieldFactory && field == velocityField)
+      return translationFieldFactory(materialMap);
+    return psSmartPointer<psTranslationField<NumericType>>::New(field,
+                                                                materialMap);
+  }
+
   /// Set a primary direction for the source distribution (tilted distribution).
   virtual std::optional<std::array<NumericType, 3>>
   getPrimaryDirection() const {
@@ -100,5 +120,22 @@ public:
   void setVelocityField(psSmartPointer<VelocityFieldType> passedVelocityField) {
     velocityField = std::dynamic_pointer_cast<psVelocityField<NumericType>>(
         passedVelocityField);
+    translationFieldFactory = nullptr;
+    if constexpr (!std::is_same_v<VelocityFieldType,
+                                  psVelocityField<NumericType>>) {
+      // the typed translation field is only valid for the exact type
+      if (passedVelocityField &&
+          typeid(*passedVelocityField) == typeid(VelocityFieldType)) {
+        translationFieldFactory =
+            [passedVelocityField](psSmartPointer<psMaterialMap> materialMap) {
+              using typedFieldType =
+                  psTypedTranslationField<NumericType, VelocityFieldType>;
+              return translationFieldType(
+                  std::dynamic_pointer_cast<psTranslationField<NumericType>>(
+                      psSmartPointer<typedFieldType>::New(passedVelocityField,
+                                                          materialMap)));
+            };
+      }
+    }
   }
 };
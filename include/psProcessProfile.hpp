@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <psCSVWriter.hpp>
+#include <psLogger.hpp>
+
+/// Timings and ray counts of tracing a single particle type.
+struct psParticleProfile {
+  double traceTime = 0.; // in seconds
+  std::size_t raysTraced = 0;
+  std::size_t reflections = 0;
+  std::size_t diskHits = 0;
+  std::size_t geometryHits = 0;
+  std::size_t nonGeometryHits = 0;
+};
+
+/// Timings (in seconds) and counts of a single time step of psProcess.
+struct psProcessStepProfile {
+  double processTime = 0.; // process time at the start of the step
+  double timeStep = 0.;
+  std::size_t numSurfacePoints = 0;
+  bool fluxesTraced = false;
+
+  double diskMeshConversion = 0.;
+  double geometryUpdate = 0.;
+  double fluxCalculation = 0.;
+  double fluxPostProcessing = 0.; // normalization and smoothing
+  double velocityCalculation = 0.;
+  double kdTreeBuild = 0.;
+  double advection = 0.;
+  double callbacks = 0.;
+  double total = 0.;
+
+  std::vector<psParticleProfile> particles;
+};
+
+/// Performance profile of a psProcess run, which can be exported as JSON or
+/// CSV, e.g. to track the performance of a simulation across versions.
+struct psProcessProfile {
+  double coverageInitialization = 0.; // in seconds
+  std::size_t coverageInitializationIterations = 0;
+  double total = 0.;
+  std::vector<psProcessStepProfile> steps;
+
+  void clear() { *this = psProcessProfile(); }
+
+  void writeJSON(const std::string &fileName) const {
+    std::ofstream file(fileName);
+    if (!file.is_open()) {
+      psLogger::getInstance()
+          .addWarning("Could not open file " + fileName)
+          .print();
+      return;
+    }
+
+    file << "{\n  \"coverageInitialization\": " << coverageInitialization
+         << ",\n  \"coverageInitializationIterations\": "
+         << coverageInitializationIterations << ",\n  \"total\": " << total
+         << ",\n  \"steps\": [";
+    for (std::size_t i = 0; i < steps.size(); ++i) {
+      const auto &step = steps[i];
+      file << (i ? "," : "") << "\n    {\"processTime\": " << step.processTime
+           << ", \"timeStep\": " << step.timeStep
+           << ", \"numSurfacePoints\": " << step.numSurfacePoints
+           << ", \"fluxesTraced\": " << (step.fluxesTraced ? "true" : "false")
+           << ", \"diskMeshConversion\": " << step.diskMeshConversion
+           << ", \"geometryUpdate\": " << step.geometryUpdate
+           << ", \"fluxCalculation\": " << step.fluxCalculation
+           << ", \"fluxPostProcessing\": " << step.fluxPostProcessing
+           << ", \"velocityCalculation\": " << step.velocityCalculation
+           << ", \"kdTreeBuild\": " << step.kdTreeBuild
+           << ", \"advection\": " << step.advection
+           << ", \"callbacks\": " << step.callbacks
+           << ", \"total\": " << step.total << ", \"particles\": [";
+      for (std::size_t j = 0; j < step.particles.size(); ++j) {
+        const auto &particle = step.particles[j];
+        file << (j ? ", " : "") << "{\"traceTime\": " << particle.traceTime
+             << ", \"raysTraced\": " << particle.raysTraced
+             << ", \"reflections\": " << particle.reflections
+             << ", \"diskHits\": " << particle.diskHits
+             << ", \"geometryHits\": " << particle.geometryHits
+             << ", \"nonGeometryHits\": " << particle.nonGeometryHits << "}";
+      }
+      file << "]}";
+    }
+    file << "\n  ]\n}\n";
+  }
+
+  // Write one row per time step. The particle columns are repeated for each
+  // particle type.
+  void writeCSV(const std::string &fileName) const {
+    std::size_t numParticles = 0;
+    for (const auto &step : steps)
+      numParticles = std::max(numParticles, step.particles.size());
+
+    std::string header =
+        "processTime,timeStep,numSurfacePoints,fluxesTraced,"
+        "diskMeshConversion,geometryUpdate,fluxCalculation,"
+        "fluxPostProcessing,velocityCalculation,kdTreeBuild,advection,"
+        "callbacks,total";
+    for (std::size_t j = 0; j < numParticles; ++j) {
+      const auto p = "particle" + std::to_string(j);
+      header += "," + p + "TraceTime," + p + "RaysTraced," + p +
+                "Reflections," + p + "DiskHits," + p + "GeometryHits," + p +
+                "NonGeometryHits";
+    }
+
+    psCSVWriter<double> writer(fileName, header);
+    for (const auto &step : steps) {
+      std::vector<double> row = {step.processTime,
+                                 step.timeStep,
+                                 double(step.numSurfacePoints),
+                                 double(step.fluxesTraced),
+                                 step.diskMeshConversion,
+                                 step.geometryUpdate,
+                                 step.fluxCalculation,
+                                 step.fluxPostProcessing,
+                                 step.velocityCalculation,
+                                 step.kdTreeBuild,
+                                 step.advection,
+                                 step.callbacks,
+                                 step.total};
+      for (std::size_t j = 0; j < numParticles; ++j) {
+        psParticleProfile particle;
+        if (j < step.particles.size())
+          particle = step.particles[j];
+        row.insert(row.end(), {particle.traceTime, double(particle.raysTraced),
+                               double(particle.reflections),
+                               double(particle.diskHits),
+                               double(particle.geometryHits),
+                               double(particle.nonGeometryHits)});
+      }
+      writer.writeRow(row);
+    }
+    writer.flush();
+  }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <psCoverageCache.hpp>
+#include <psDomain.hpp>
+#include <psLogger.hpp>
+#include <psProcess.hpp>
+#include <psProcessModel.hpp>
+#include <psSmartPointer.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// Runs several process variants, which differ only in the process model or
+/// its parameters, on copies of the same initial domain. The variants are
+/// distributed over the available threads, each variant using a configurable
+/// number of threads itself. All variants share a coverage cache, so only the
+/// first variants have to initialize their coverages from scratch.
+template <typename NumericType, int D> class psProcessSweep {
+  using psDomainType = psSmartPointer<psDomain<NumericType, D>>;
+  using processModelType = psSmartPointer<psProcessModel<NumericType, D>>;
+  using setupFunctionType =
+      std::function<void(psProcess<NumericType, D> &, std::size_t)>;
+
+  struct Variant {
+    processModelType model;
+    NumericType duration;
+    std::optional<std::size_t> parameterKey;
+  };
+
+  psDomainType domain = nullptr;
+  std::vector<Variant> variants;
+  std::vector<psDomainType> results;
+  std::vector<psProcessProfile> profiles;
+  setupFunctionType processSetup = nullptr;
+  psSmartPointer<psCoverageCache<NumericType>> coverageCache =
+      psSmartPointer<psCoverageCache<NumericType>>::New();
+  int threadsPerJob = 1;
+
+public:
+  psProcessSweep() {}
+
+  psProcessSweep(psDomainType passedDomain) : domain(passedDomain) {}
+
+  // Set the initial domain. It is not modified by the sweep; each variant is
+  // applied to its own copy.
+  void setDomain(psDomainType passedDomain) { domain = passedDomain; }
+
+  // Add a process variant. Every variant needs its own model instance, since
+  // the surface model stores the coverages of the running process. Without a
+  // parameter key, the coverages of the variant are only seeded from the
+  // cache and always converged from there. Its cache entry is identified by
+  // the process name and process parameters, so it is replaced by later
+  // variants of the same model on the same geometry.
+  template <class ProcessModelType>
+  std::size_t insertNextVariant(psSmartPointer<ProcessModelType> passedModel,
+                                NumericType passedDuration) {
+    return addVariant(passedModel, passedDuration, std::nullopt);
+  }
+
+  // Add a process variant with a parameter key identifying its model
+  // parameters in the coverage cache. Variants with the same key and process
+  // parameters skip the coverage initialization on a geometry which is
+  // already in the cache, e.g. when a sweep is repeated with the coverage
+  // cache of a previous sweep.
+  template <class ProcessModelType>
+  std::size_t insertNextVariant(psSmartPointer<ProcessModelType> passedModel,
+                                NumericType passedDuration,
+                                std::size_t parameterKey) {
+    return addVariant(passedModel, passedDuration, parameterKey);
+  }
+
+  // Set a function which configures the process of each variant (e.g. the
+  // number of rays per point) before it is applied. The function receives
+  // the process and the index of the variant and may be called concurrently.
+  void setProcessSetup(setupFunctionType passedSetup) {
+    processSetup = passedSetup;
+  }
+
+  // Set the number of threads used by each variant. The variants are then run
+  // concurrently on the remaining threads. Defaults to 1.
+  void setThreadsPerJob(int passedThreads) {
+    threadsPerJob = std::max(passedThreads, 1);
+  }
+
+  // Set the coverage cache shared by all variants, e.g. to reuse coverages
+  // from a previous sweep.
+  void
+  setCoverageCache(psSmartPointer<psCoverageCache<NumericType>> passedCache) {
+    coverageCache = passedCache;
+  }
+
+  void apply() {
+    if (!domain) {
+      psLogger::getInstance()
+          .addWarning("No domain passed to psProcessSweep.")
+          .print();
+      return;
+    }
+
+    const long numVariants = variants.size();
+    results.assign(numVariants, nullptr);
+    profiles.assign(numVariants, psProcessProfile());
+
+#ifdef _OPENMP
+    const int maxThreads = omp_get_max_threads();
+    const int numJobs = std::max(1, maxThreads / threadsPerJob);
+    const int maxActiveLevels = omp_get_max_active_levels();
+    omp_set_max_active_levels(std::max(maxActiveLevels, 2));
+#endif
+
+#pragma omp parallel for schedule(dynamic) num_threads(numJobs)
+    for (long i = 0; i < numVariants; ++i) {
+#ifdef _OPENMP
+      omp_set_num_threads(threadsPerJob);
+#endif
+      // the domain is copied by the thread running the variant
+      auto variantDomain = psDomainType::New(domain);
+
+      psProcess<NumericType, D> process(variantDomain, variants[i].model,
+                                        variants[i].duration);
+      if (variants[i].parameterKey)
+        process.setCoverageCache(coverageCache, *variants[i].parameterKey);
+      else
+        process.setCoverageCache(coverageCache);
+      if (processSetup)
+        processSetup(process, i);
+      process.apply();
+
+      results[i] = variantDomain;
+      profiles[i] = process.getProfile();
+    }
+
+#ifdef _OPENMP
+    omp_set_max_active_levels(maxActiveLevels);
+#endif
+  }
+
+  // Returns the resulting domain of each variant.
+  const std::vector<psDomainType> &getResults() const { return results; }
+
+  // Returns the profile of each variant.
+  const std::vector<psProcessProfile> &getProfiles() const { return profiles; }
+
+  auto getCoverageCache() const { return coverageCache; }
+
+private:
+  template <class ProcessModelType>
+  std::size_t addVariant(psSmartPointer<ProcessModelType> passedModel,
+                         NumericType passedDuration,
+                         std::optional<std::size_t> parameterKey) {
+    for (const auto &variant : variants) {
+      if (variant.model == passedModel) {
+        psLogger::getInstance()
+            .addWarning("Process model is already used by another variant "
+                        "in psProcessSweep.")
+            .print();
+        return variants.size();
+      }
+    }
+    auto model =
+        std::dynamic_pointer_cast<psProcessModel<NumericType, D>>(passedModel);
+    variants.push_back({model, passedDuration, parameterKey});
+    return variants.size() - 1;
+  }
+};
@@ -1,30 +1,58 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <hrleSparseIterator.hpp>
+#include <lsDomain.hpp>
 #include <lsVelocityField.hpp>
 #include <psKDTree.hpp>
+#include <psLogger.hpp>
+#include <psMaterials.hpp>
+#include <psUtils.hpp>
 #include <psVelocityField.hpp>
 
+/// Passes the velocities of the process velocity field to the level set
+/// advection, translating level set point ids to surface point ids and level
+/// set indices to materials.
 template <typename NumericType>
 class psTranslationField : public lsVelocityField<NumericType> {
-  using translatorType = std::unordered_map<unsigned long, unsigned long>;
+protected:
   const int translationMethod = 1;
 
 public:
+  // Maps level set point ids to surface point ids, as generated by
+  // lsToDiskMesh.
+  using translatorType = std::unordered_map<unsigned long, unsigned long>;
+  // Dense version of the translator, indexed by the level set point id.
+  // Level set points without a surface point are set to unmappedId.
+  using denseTranslatorType = std::vector<unsigned long>;
+  static constexpr unsigned long unmappedId =
+      std::numeric_limits<unsigned long>::max();
+
   psTranslationField(
       psSmartPointer<psVelocityField<NumericType>> passedVeloField,
       psSmartPointer<psMaterialMap> passedMaterialMap)
       : translationMethod(passedVeloField->getTranslationFieldOptions()),
-        modelVelocityField(passedVeloField), materialMap(passedMaterialMap) {}
+        modelVelocityField(passedVeloField), materialMap(passedMaterialMap) {
+    updateMaterialTable();
+  }
 
   NumericType getScalarVelocity(const std::array<NumericType, 3> &coordinate,
                                 int material,
                                 const std::array<NumericType, 3> &normalVector,
                                 unsigned long pointId) {
+    NumericType velocity;
+    if (findPointVelocity(pointId, velocity))
+      return velocity;
     if (translationMethod > 0)
       translateLsId(pointId, coordinate);
-    if (materialMap)
-      material = static_cast<int>(materialMap->getMaterialAtIdx(material));
+    material = translateMaterial(material);
     return modelVelocityField->getScalarVelocity(coordinate, material,
                                                  normalVector, pointId);
   }
@@ -35,8 +63,7 @@ public:
                     unsigned long pointId) {
     if (translationMethod > 0)
       translateLsId(pointId, coordinate);
-    if (materialMap)
-      material = static_cast<int>(materialMap->getMaterialAtIdx(material));
+    material = translateMaterial(material);
     return modelVelocityField->getVectorVelocity(coordinate, material,
                                                  normalVector, pointId);
   }
@@ -44,29 +71,80 @@ public:
   NumericType
   getDissipationAlpha(int direction, int material,
                       const std::array<NumericType, 3> &centralDifferences) {
-    if (materialMap)
-      material = static_cast<int>(materialMap->getMaterialAtIdx(material));
+    material = translateMaterial(material);
     return modelVelocityField->getDissipationAlpha(direction, material,
                                                    centralDifferences);
   }
 
-  void setTranslator(psSmartPointer<translatorType> passedTranslator) {
+  void setTranslator(psSmartPointer<denseTranslatorType> passedTranslator) {
     translator = passedTranslator;
   }
 
+  // Convert the translator generated by lsToDiskMesh into its dense version.
+  // The storage of the dense translator is reused.
+  static void toDenseTranslator(const translatorType &translator,
+                                const std::size_t numLsPoints,
+                                denseTranslatorType &denseTranslator) {
+    denseTranslator.assign(numLsPoints, unmappedId);
+    for (const auto &it : translator) {
+      if (it.first >= denseTranslator.size())
+        denseTranslator.resize(it.first + 1, unmappedId);
+      denseTranslator[it.first] = it.second;
+    }
+  }
+
   void buildKdTree(const std::vector<std::array<NumericType, 3>> &points) {
     kdTree.setPoints(points);
     kdTree.build();
   }
 
+  // Resolve the velocity field for all points in the narrow band of the top
+  // level set once before the advection step, so the queries during the
+  // advection become array reads. With the kd-tree translation, the nearest
+  // surface point of each level set point is looked up here. If the velocity
+  // field only depends on the surface point, the scalar velocities are
+  // evaluated here as well. Has to be called again whenever the level set,
+  // the translator or the velocities change. The resolved data is only valid
+  // for a single advection step, since the point ids change in every step.
+  template <int D>
+  void
+  prepareAdvection(psSmartPointer<lsDomain<NumericType, D>> passedLevelSet) {
+    updateMaterialTable();
+    const auto numPoints = passedLevelSet->getNumberOfPoints();
+
+    nearestIds.clear();
+    if (translationMethod == 2)
+      findNearestSurfacePoints(*passedLevelSet);
+
+    pointVelocities.clear();
+    if (translationMethod == 0 || !modelVelocityField->useOnlyPointId())
+      return;
+
+    const auto &surfaceIds = translationMethod == 2 ? nearestIds : *translator;
+    pointVelocities.assign(numPoints,
+                           std::numeric_limits<NumericType>::quiet_NaN());
+    evaluatePointVelocities(surfaceIds);
+  }
+
+  // Discard the data resolved by prepareAdvection, so all queries are
+  // evaluated during the advection again.
+  void clearPreparedAdvection() {
+    nearestIds.clear();
+    pointVelocities.clear();
+  }
+
   void translateLsId(unsigned long &lsId,
                      const std::array<NumericType, 3> &coordinate) {
     if (translationMethod == 2) {
-      auto nearest = kdTree.findNearest(coordinate);
-      lsId = nearest->first;
+      if (lsId < nearestIds.size() && nearestIds[lsId] != unmappedId) {
+        lsId = nearestIds[lsId];
+      } else {
+        auto nearest = kdTree.findNearest(coordinate);
+        lsId = nearest->first;
+      }
     } else {
-      if (auto it = translator->find(lsId); it != translator->end()) {
-        lsId = it->second;
+      if (lsId < translator->size() && (*translator)[lsId] != unmappedId) {
+        lsId = (*translator)[lsId];
       } else {
         psLogger::getInstance()
             .addWarning("Could not extend velocity from surface to LS point")
@@ -76,9 +154,167 @@ public:
     // }
   }
 
+protected:
+  // Velocities of the level set points, NaN if not precomputed.
+  std::vector<NumericType> pointVelocities;
+
+  // Evaluate the velocity of every level set point which is mapped to a
+  // surface point.
+  virtual void evaluatePointVelocities(const denseTranslatorType &surfaceIds) {
+    const std::array<NumericType, 3> origin{0., 0., 0.};
+    const long numIds = std::min(pointVelocities.size(), surfaceIds.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < numIds; ++i) {
+      if (surfaceIds[i] != unmappedId)
+        pointVelocities[i] = modelVelocityField->getScalarVelocity(
+            origin, 0, origin, surfaceIds[i]);
+    }
+  }
+
+  bool findPointVelocity(unsigned long pointId, NumericType &velocity) const {
+    if (pointId >= pointVelocities.size() ||
+        std::isnan(pointVelocities[pointId]))
+      return false;
+    velocity = pointVelocities[pointId];
+    return true;
+  }
+
+  int translateMaterial(int material) const {
+    if (!materialMap)
+      return material;
+    if (material >= 0 &&
+        static_cast<std::size_t>(material) < materialTable.size())
+      return materialTable[material];
+    return static_cast<int>(materialMap->getMaterialAtIdx(material));
+  }
+
 private:
-  psSmartPointer<translatorType> translator;
+  // Look up the nearest surface point of all narrow band points in one batch.
+  // The queries are sorted along a Morton curve, so each thread resolves
+  // queries in the same region of the kd-tree, which keeps the visited tree
+  // nodes in cache.
+  template <int D>
+  void findNearestSurfacePoints(const lsDomain<NumericType, D> &levelSet) {
+    std::vector<unsigned long> lsIds;
+    std::vector<std::array<hrleIndexType, D>> indices;
+    std::array<hrleIndexType, D> minIndex;
+    minIndex.fill(std::numeric_limits<hrleIndexType>::max());
+    for (hrleConstSparseIterator<typename lsDomain<NumericType, D>::DomainType>
+             it(levelSet.getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || std::abs(it.getValue()) > 0.5)
+        continue;
+      std::array<hrleIndexType, D> index;
+      for (unsigned i = 0; i < D; ++i) {
+        index[i] = it.getStartIndices(i);
+        minIndex[i] = std::min(minIndex[i], index[i]);
+      }
+      lsIds.push_back(it.getPointId());
+      indices.push_back(index);
+    }
+
+    const long numQueries = lsIds.size();
+    std::vector<std::pair<std::uint64_t, long>> order(numQueries);
+#pragma omp parallel for schedule(static)
+    for (long n = 0; n < numQueries; ++n) {
+      std::array<std::uint32_t, 3> shifted{0, 0, 0};
+      for (unsigned i = 0; i < D; ++i)
+        shifted[i] = static_cast<std::uint32_t>(indices[n][i] - minIndex[i]);
+      order[n] = {psUtils::mortonCode(shifted), n};
+    }
+    std::sort(order.begin(), order.end());
+
+    const auto gridDelta = levelSet.getGrid().getGridDelta();
+    nearestIds.assign(levelSet.getNumberOfPoints(), unmappedId);
+#pragma omp parallel for schedule(static)
+    for (long n = 0; n < numQueries; ++n) {
+      const auto q = order[n].second;
+      std::array<NumericType, 3> coordinate{0., 0., 0.};
+      for (unsigned i = 0; i < D; ++i)
+        coordinate[i] = indices[q][i] * gridDelta;
+      nearestIds[lsIds[q]] = kdTree.findNearest(coordinate)->first;
+    }
+  }
+
+  // Flatten the material map into a table, so the material of a level set
+  // does not have to be looked up in the map for every query.
+  void updateMaterialTable() {
+    materialTable.clear();
+    if (!materialMap)
+      return;
+    materialTable.resize(materialMap->size());
+    for (std::size_t i = 0; i < materialTable.size(); ++i)
+      materialTable[i] = static_cast<int>(materialMap->getMaterialAtIdx(i));
+  }
+
+  psSmartPointer<denseTranslatorType> translator;
+  denseTranslatorType nearestIds;
+  std::vector<int> materialTable;
   psKDTree<NumericType, std::array<NumericType, 3>> kdTree;
   const psSmartPointer<psVelocityField<NumericType>> modelVelocityField;
   const psSmartPointer<psMaterialMap> materialMap;
 };
+
+/// Translation field for a velocity field whose type is known at compile
+/// time. The velocity functions are called without virtual dispatch, so they
+/// can be inlined into the advection and the batched evaluation of the point
+/// velocities. The dynamic type of the velocity field has to be exactly
+/// VelocityFieldType.
+template <typename NumericType, class VelocityFieldType>
+class psTypedTranslationField final : public psTranslationField<NumericType> {
+  using BaseType = psTranslationField<NumericType>;
+  const psSmartPointer<VelocityFieldType> velocityField;
+
+public:
+  psTypedTranslationField(psSmartPointer<VelocityFieldType> passedVeloField,
+                          psSmartPointer<psMaterialMap> passedMaterialMap)
+      : BaseType(std::dynamic_pointer_cast<psVelocityField<NumericType>>(
+                     passedVeloField),
+                 passedMaterialMap),
+        velocityField(passedVeloField) {}
+
+  NumericType getScalarVelocity(const std::array<NumericType, 3> &coordinate,
+                                int material,
+                                const std::array<NumericType, 3> &normalVector,
+                                unsigned long pointId) override {
+    NumericType velocity;
+    if (this->findPointVelocity(pointId, velocity))
+      return velocity;
+    if (this->translationMethod > 0)
+      this->translateLsId(pointId, coordinate);
+    return velocityField->VelocityFieldType::getScalarVelocity(
+        coordinate, this->translateMaterial(material), normalVector, pointId);
+  }
+
+  std::array<NumericType, 3>
+  getVectorVelocity(const std::array<NumericType, 3> &coordinate, int material,
+                    const std::array<NumericType, 3> &normalVector,
+                    unsigned long pointId) override {
+    if (this->translationMethod > 0)
+      this->translateLsId(pointId, coordinate);
+    return velocityField->VelocityFieldType::getVectorVelocity(
+        coordinate, this->translateMaterial(material), normalVector, pointId);
+  }
+
+  NumericType getDissipationAlpha(
+      int direction, int material,
+      const std::array<NumericType, 3> &centralDifferences) override {
+    return velocityField->VelocityFieldType::getDissipationAlpha(
+        direction, this->translateMaterial(material), centralDifferences);
+  }
+
+protected:
+  void evaluatePointVelocities(
+      const typename BaseType::denseTranslatorType &surfaceIds) override {
+    auto &pointVelocities = this->pointVelocities;
+    const std::array<NumericType, 3> origin{0., 0., 0.};
+    const long numIds = std::min(pointVelocities.size(), surfaceIds.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < numIds; ++i) {
+      if (surfaceIds[i] != BaseType::unmappedId)
+        pointVelocities[i] =
+            velocityField->VelocityFieldType::getScalarVelocity(
+                origin, 0, origin, surfaceIds[i]);
+    }
+  }
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -9,6 +11,7 @@
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 namespace psUtils {
 
@@ -218,4 +221,62 @@ std::string arrayToString(const std::array<NumericType, D> arr) {
   return arrayStr.str();
 }
 
+// Morton (Z-order) code of non-negative grid indices, using the lowest 21 bits
+// of each index. Sorting points by their code keeps points which are close
+// in space close in memory.
+inline std::uint64_t mortonCode(const std::array<std::uint32_t, 3> &indices) {
+  std::uint64_t code = 0;
+  for (unsigned bit = 0; bit < 21; ++bit) {
+    for (unsigned i = 0; i < 3; ++i) {
+      code |= std::uint64_t((indices[i] >> bit) & 1u) << (3 * bit + i);
+    }
+  }
+  return code;
+}
+
+// Binary serialization helpers, used for checkpoint files. Values are written
+// in the native byte order.
+template <class T> void writeBinary(std::ostream &stream, const T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <class T>
+void writeBinary(std::ostream &stream, const std::vector<T> &values) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  writeBinary(stream, static_cast<std::uint64_t>(values.size()));
+  stream.write(reinterpret_cast<const char *>(values.data()),
+               values.size() * sizeof(T));
+}
+
+inline void writeBinary(std::ostream &stream, const std::string &value) {
+  writeBinary(stream, static_cast<std::uint64_t>(value.size()));
+  stream.write(value.data(), value.size());
+}
+
+template <class T> void readBinary(std::istream &stream, T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+template <class T>
+void readBinary(std::istream &stream, std::vector<T> &values) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  std::uint64_t size = 0;
+  readBinary(stream, size);
+  if (!stream)
+    return;
+  values.resize(size);
+  stream.read(reinterpret_cast<char *>(values.data()), size * sizeof(T));
+}
+
+inline void readBinary(std::istream &stream, std::string &value) {
+  std::uint64_t size = 0;
+  readBinary(stream, size);
+  if (!stream)
+    return;
+  value.resize(size);
+  stream.read(value.data(), size);
+}
+
 }; // namespace psUtils
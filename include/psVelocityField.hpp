@@ -1,6 +1,7 @@
 #pragma once
 
 #include <psSmartPointer.hpp>
+#include <typeinfo>
 #include <vector>
 
 template <typename NumericType> class psVelocityField {
@@ -35,6 +36,11 @@ public:
   // 1: use unordered map to translate level set ID to surface ID
   // 2: use kd-tree to translate level set ID to surface ID
   virtual int getTranslationFieldOptions() const { return 1; }
+
+  // Return true if the scalar velocity only depends on the surface point id.
+  // The velocities of all level set points are then evaluated once before
+  // each advection step.
+  virtual bool useOnlyPointId() const { return false; }
 };
 
 template <typename NumericType>
@@ -59,6 +65,12 @@ public:
     return translationFieldOptions;
   }
 
+  // Derived velocity fields may depend on more than the point id, so they
+  // have to opt in themselves.
+  bool useOnlyPointId() const override {
+    return typeid(*this) == typeid(psDefaultVelocityField<NumericType>);
+  }
+
 private:
   psSmartPointer<std::vector<NumericType>> velocities;
   const int translationFieldOptions = 1; // default: use map translator
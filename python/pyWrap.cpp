@@ -66,6 +66,10 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .value("DEBUG", psLogLevel::DEBUG)
       .export_values();
 
+  pybind11::enum_<psCoverageResidualNorm>(module, "CoverageResidualNorm")
+      .value("MAX", psCoverageResidualNorm::MAX)
+      .value("L2", psCoverageResidualNorm::L2);
+
   // some unexpected behaviour can happen as it is working with multithreading
   pybind11::class_<psLogger, psSmartPointer<psLogger>>(module, "Logger")
       .def_static("setLogLevel", &psLogger::setLogLevel)
@@ -97,6 +101,7 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("getDissipationAlpha", &psVelocityField<T>::getDissipationAlpha)
       .def("getTranslationFieldOptions",
            &psVelocityField<T>::getTranslationFieldOptions)
+      .def("useOnlyPointId", &psVelocityField<T>::useOnlyPointId)
       .def("setVelocities", &psVelocityField<T>::setVelocities);
 
   pybind11::class_<psDefaultVelocityField<T>,
@@ -111,6 +116,7 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
            &psDefaultVelocityField<T>::getDissipationAlpha)
       .def("getTranslationFieldOptions",
            &psDefaultVelocityField<T>::getTranslationFieldOptions)
+      .def("useOnlyPointId", &psDefaultVelocityField<T>::useOnlyPointId)
       .def("setVelocities", &psDefaultVelocityField<T>::setVelocities);
 
   // psDomain
@@ -132,7 +138,10 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("setMaterialMap", &psDomain<T, D>::setMaterialMap)
       .def("getMaterialMap", &psDomain<T, D>::getMaterialMap)
       .def("generateCellSet", &psDomain<T, D>::generateCellSet,
-           "Generate the cell set.")
+           pybind11::arg("depth") = 0.,
+           pybind11::arg("cellSetAboveSurface") = false,
+           pybind11::arg("structuredGrid") = false,
+           pybind11::arg("surfaceBandWidth") = 0., "Generate the cell set.")
       .def("getLevelSets",
            [](psDomain<T, D> &d)
                -> std::optional<std::vector<psSmartPointer<lsDomain<T, D>>>> {
@@ -207,6 +216,9 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
           "Add a scalar value to be stored and modified in each cell.")
       .def("getCellGrid", &csDenseCellSet<T, D>::getCellGrid,
            "Get the underlying mesh of the cell set.")
+      .def("getCellMesh", &csDenseCellSet<T, D>::getCellMesh,
+           "Get a copy of the cell set as a mesh. For a structured cell set, "
+           "the nodes and elements are generated.")
       .def("getDepth", &csDenseCellSet<T, D>::getDepth,
            "Get the depth of the cell set.")
       .def("getGridDelta", &csDenseCellSet<T, D>::getGridDelta,
@@ -230,6 +242,16 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("setPeriodicBoundary", &csDenseCellSet<T, D>::setPeriodicBoundary,
            "Enable periodic boundary conditions in specified dimensions.")
       .def("getCellSetPosition", &csDenseCellSet<T, D>::getCellSetPosition)
+      .def("setStructuredGrid", &csDenseCellSet<T, D>::setStructuredGrid,
+           "Set whether the cells should be stored on a structured grid "
+           "instead of a hexahedral mesh.")
+      .def("getStructuredGrid", &csDenseCellSet<T, D>::getStructuredGrid)
+      .def("setSurfaceBandWidth", &csDenseCellSet<T, D>::setSurfaceBandWidth,
+           "Only create cells within the given distance of the surface. "
+           "Requires the structured grid mode.")
+      .def("getSurfaceBandWidth", &csDenseCellSet<T, D>::getSurfaceBandWidth)
+      .def("getCellCenter", &csDenseCellSet<T, D>::getCellCenter,
+           "Get the center of the cell with the given index.")
       .def("setFillingFraction",
            pybind11::overload_cast<const int, const T>(
                &csDenseCellSet<T, D>::setFillingFraction),
@@ -418,6 +440,58 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("setPrimaryDirection", &psProcessModel<T, D>::setPrimaryDirection)
       .def("getPrimaryDirection", &psProcessModel<T, D>::getPrimaryDirection);
 
+  // psCoverageCache
+  pybind11::class_<psCoverageCache<T>, psSmartPointer<psCoverageCache<T>>>(
+      module, "CoverageCache")
+      .def(pybind11::init(&psSmartPointer<psCoverageCache<T>>::New<>))
+      .def("save", &psCoverageCache<T>::save,
+           "Save all cached coverages to a file.")
+      .def("load", &psCoverageCache<T>::load,
+           "Add the coverages stored in a file to the cache.")
+      .def("size", &psCoverageCache<T>::size)
+      .def("clear", &psCoverageCache<T>::clear);
+
+  // psProcessProfile
+  pybind11::class_<psParticleProfile>(module, "ParticleProfile")
+      .def_readonly("traceTime", &psParticleProfile::traceTime)
+      .def_readonly("raysTraced", &psParticleProfile::raysTraced)
+      .def_readonly("reflections", &psParticleProfile::reflections)
+      .def_readonly("diskHits", &psParticleProfile::diskHits)
+      .def_readonly("geometryHits", &psParticleProfile::geometryHits)
+      .def_readonly("nonGeometryHits", &psParticleProfile::nonGeometryHits);
+
+  pybind11::class_<psProcessStepProfile>(module, "ProcessStepProfile")
+      .def_readonly("processTime", &psProcessStepProfile::processTime)
+      .def_readonly("timeStep", &psProcessStepProfile::timeStep)
+      .def_readonly("numSurfacePoints",
+                    &psProcessStepProfile::numSurfacePoints)
+      .def_readonly("fluxesTraced", &psProcessStepProfile::fluxesTraced)
+      .def_readonly("diskMeshConversion",
+                    &psProcessStepProfile::diskMeshConversion)
+      .def_readonly("geometryUpdate", &psProcessStepProfile::geometryUpdate)
+      .def_readonly("fluxCalculation", &psProcessStepProfile::fluxCalculation)
+      .def_readonly("fluxPostProcessing",
+                    &psProcessStepProfile::fluxPostProcessing)
+      .def_readonly("velocityCalculation",
+                    &psProcessStepProfile::velocityCalculation)
+      .def_readonly("kdTreeBuild", &psProcessStepProfile::kdTreeBuild)
+      .def_readonly("advection", &psProcessStepProfile::advection)
+      .def_readonly("callbacks", &psProcessStepProfile::callbacks)
+      .def_readonly("total", &psProcessStepProfile::total)
+      .def_readonly("particles", &psProcessStepProfile::particles);
+
+  pybind11::class_<psProcessProfile>(module, "ProcessProfile")
+      .def_readonly("coverageInitialization",
+                    &psProcessProfile::coverageInitialization)
+      .def_readonly("coverageInitializationIterations",
+                    &psProcessProfile::coverageInitializationIterations)
+      .def_readonly("total", &psProcessProfile::total)
+      .def_readonly("steps", &psProcessProfile::steps)
+      .def("writeJSON", &psProcessProfile::writeJSON,
+           "Write the profile to a JSON file.")
+      .def("writeCSV", &psProcessProfile::writeCSV,
+           "Write the profile to a CSV file with one row per time step.");
+
   // psProcess
   pybind11::class_<psProcess<T, D>>(module, "Process")
       // constructors
@@ -443,6 +517,60 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("setNumberOfRaysPerPoint", &psProcess<T, D>::setNumberOfRaysPerPoint,
            "Set the number of rays to traced for each particle in the process. "
            "The number is per point in the process geometry.")
+      .def("enableAdaptiveRaysPerPoint",
+           &psProcess<T, D>::enableAdaptiveRaysPerPoint,
+           pybind11::arg("targetRelativeError"),
+           pybind11::arg("maxRaysPerPoint"),
+           "Trace additional rays for each particle until the relative flux "
+           "error reaches the target or the maximum number of rays per point "
+           "is used up.")
+      .def("disableAdaptiveRaysPerPoint",
+           &psProcess<T, D>::disableAdaptiveRaysPerPoint,
+           "Disable adaptive sampling of the fluxes.")
+      .def("setFluxBlendingFactor", &psProcess<T, D>::setFluxBlendingFactor,
+           "Set the weight of the newly traced rates when blending them with "
+           "the rates of the previous time step. A factor of 1 (default) "
+           "disables blending.")
+      .def("getProfile", &psProcess<T, D>::getProfile,
+           pybind11::return_value_policy::copy,
+           "Get the timings and ray counts of the last process run.")
+      .def("setCoverageCache",
+           pybind11::overload_cast<psSmartPointer<psCoverageCache<T>>>(
+               &psProcess<T, D>::setCoverageCache),
+           pybind11::arg("cache"),
+           "Set a cache of converged coverages used to initialize the "
+           "coverages.")
+      .def("setCoverageCache",
+           pybind11::overload_cast<psSmartPointer<psCoverageCache<T>>,
+                                   std::size_t>(
+               &psProcess<T, D>::setCoverageCache),
+           pybind11::arg("cache"), pybind11::arg("parameterKey"),
+           "Set a cache of converged coverages and a key of the model "
+           "parameters, which allows skipping the initialization.")
+      .def("setCoverageConvergenceTolerance",
+           &psProcess<T, D>::setCoverageConvergenceTolerance,
+           pybind11::arg("tolerance"),
+           pybind11::arg("norm") = psCoverageResidualNorm::MAX,
+           "Set the tolerance of the coverage change below which the coverage "
+           "initialization stops early.")
+      .def("getCoverageResidualHistory",
+           &psProcess<T, D>::getCoverageResidualHistory,
+           "Get the maximum coverage change of each iteration of the last "
+           "coverage initialization.")
+      .def("setFluxUpdateInterval", &psProcess<T, D>::setFluxUpdateInterval,
+           pybind11::arg("maxSteps"), pybind11::arg("maxDisplacement") = 0.,
+           "Recalculate the fluxes only every maxSteps advection steps or "
+           "once the surface moved more than maxDisplacement grid spacings.")
+      .def("enableCheckpointing", &psProcess<T, D>::enableCheckpointing,
+           pybind11::arg("fileName"), pybind11::arg("everyNSteps"),
+           pybind11::arg("everyNSeconds") = 0.,
+           "Periodically write a checkpoint of the running process to the "
+           "given file.")
+      .def("disableCheckpointing", &psProcess<T, D>::disableCheckpointing,
+           "Disable writing checkpoints.")
+      .def("resumeFromCheckpoint", &psProcess<T, D>::resumeFromCheckpoint,
+           "Resume the process from a checkpoint file in the next call to "
+           "apply().")
       .def("setMaxCoverageInitIterations",
            &psProcess<T, D>::setMaxCoverageInitIterations,
            "Set the number of iterations to initialize the coverages.")
@@ -459,6 +587,11 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
            "sets the maximum distance a surface can be moved during one "
            "advection step. It MUST be below 0.5 to guarantee numerical "
            "stability. Defaults to 0.4999.")
+      .def("setGeometryUpdateTolerance",
+           &psProcess<T, D>::setGeometryUpdateTolerance,
+           "Set the maximum displacement (in units of the grid delta) of the "
+           "surface points for which the ray tracing geometry of the previous "
+           "time step is reused. Defaults to 0.")
       .def("enableFluxSmoothing", &psProcess<T, D>::enableFluxSmoothing,
            "Enable flux smoothing. The flux at each surface point, calculated "
            "by the ray tracer, is averaged over the surface point neighbors.")
@@ -856,7 +989,10 @@ PYBIND11_MODULE(VIENNAPS_MODULE_NAME, module) {
       .def("setMaterialMap", &psDomain<T, 3>::setMaterialMap)
       .def("getMaterialMap", &psDomain<T, 3>::getMaterialMap)
       .def("generateCellSet", &psDomain<T, 3>::generateCellSet,
-           "Generate the cell set.")
+           pybind11::arg("depth") = 0.,
+           pybind11::arg("cellSetAboveSurface") = false,
+           pybind11::arg("structuredGrid") = false,
+           pybind11::arg("surfaceBandWidth") = 0., "Generate the cell set.")
       .def("getLevelSets",
            [](psDomain<T, 3> &d)
                -> std::optional<std::vector<psSmartPointer<lsDomain<T, 3>>>> {
@@ -21,6 +21,7 @@
 
 // all header files which define API functions
 #include <psAdvectionCallback.hpp>
+#include <psCoverageCache.hpp>
 #include <psDomain.hpp>
 #include <psExtrude.hpp>
 #include <psGDSGeometry.hpp>
@@ -295,6 +296,10 @@ public:
   int getTranslationFieldOptions() const override {
     PYBIND11_OVERRIDE(int, psVelocityField<T>, getTranslationFieldOptions, );
   }
+
+  bool useOnlyPointId() const override {
+    PYBIND11_OVERRIDE(bool, psVelocityField<T>, useOnlyPointId, );
+  }
 };
 
 // a function to declare GeometricDistributionModel of type DistType
@@ -0,0 +1,45 @@
+#include <geometries/psMakeTrench.hpp>
+#include <psProcess.hpp>
+#include <psSingleParticleProcess.hpp>
+#include <psTestAssert.hpp>
+
+template <class NumericType, int D> void psRunTest() {
+  const unsigned raysPerPoint = 10;
+  const unsigned maxRaysPerPoint = 40;
+
+  // Runs a deposition in a trench and returns the number of rays traced in
+  // the first time step. A non-positive target error disables the adaptive
+  // sampling.
+  auto tracedRays = [&](NumericType targetError) {
+    auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+    psMakeTrench<NumericType, D>(domain, 0.1, 1., 1., 0.4, 0.5).apply();
+    domain->duplicateTopLevelSet();
+
+    auto model = psSmartPointer<psSingleParticleProcess<NumericType, D>>::New(
+        1., 0.1, 1.);
+    psProcess<NumericType, D> process(domain, model, 0.1);
+    process.setNumberOfRaysPerPoint(raysPerPoint);
+    if (targetError > 0.)
+      process.enableAdaptiveRaysPerPoint(targetError, maxRaysPerPoint);
+    process.apply();
+
+    const auto &steps = process.getProfile().steps;
+    PSTEST_ASSERT(!steps.empty());
+    PSTEST_ASSERT(steps.front().particles.size() == 1);
+    return steps.front().particles.front().raysTraced;
+  };
+
+  const auto fixedRays = tracedRays(0.);
+  PSTEST_ASSERT(fixedRays > 0);
+
+  // the flux error of 10 rays per point lies above the target, so more rays
+  // are traced, up to the maximum
+  const auto refinedRays = tracedRays(1e-3);
+  PSTEST_ASSERT(refinedRays > 2 * fixedRays);
+  PSTEST_ASSERT(refinedRays <= fixedRays * maxRaysPerPoint / raysPerPoint);
+
+  // a target above the error does not trace additional rays
+  PSTEST_ASSERT(tracedRays(10.) == fixedRays);
+}
+
+int main() { PSRUN_ALL_TESTS }
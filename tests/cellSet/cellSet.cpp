@@ -0,0 +1,170 @@
+#include <csDenseCellSet.hpp>
+#include <csTracing.hpp>
+#include <psTestAssert.hpp>
+
+#include <lsBooleanOperation.hpp>
+#include <lsMakeGeometry.hpp>
+
+// Particle adding to the filling fraction of every cell it passes through.
+template <class NumericType, int D>
+class FillingParticle
+    : public csParticle<FillingParticle<NumericType, D>, NumericType> {
+public:
+  NumericType
+  collision(csVolumeParticle<NumericType> &particle, rayRNG &RNG,
+            std::vector<csVolumeParticle<NumericType>> &particleStack)
+      override final {
+    return 1.;
+  }
+
+  csPair<NumericType> getMeanFreePath() const override final {
+    return {0.02, 0.01};
+  }
+};
+
+// The structured grid has to contain the same cells in the same order as the
+// hexahedral mesh created by lsToVoxelMesh.
+template <class NumericType, int D>
+void compareCellSets(csDenseCellSet<NumericType, D> &meshCellSet,
+                     csDenseCellSet<NumericType, D> &structuredCellSet) {
+  const auto numCells = meshCellSet.getNumberOfCells();
+  const auto gridDelta = meshCellSet.getGridDelta();
+  PSTEST_ASSERT(numCells > 0);
+  PSTEST_ASSERT(structuredCellSet.getNumberOfCells() == numCells);
+
+  auto meshMaterials = meshCellSet.getScalarData("Material");
+  auto structuredMaterials = structuredCellSet.getScalarData("Material");
+  for (unsigned long i = 0; i < numCells; ++i) {
+    const auto center = meshCellSet.getCellCenter(i);
+    PSTEST_ASSERT(csUtil::distance(structuredCellSet.getCellCenter(i),
+                                   center) < 1e-4 * gridDelta);
+    PSTEST_ASSERT(meshCellSet.getIndex(center) == static_cast<int>(i));
+    PSTEST_ASSERT(structuredCellSet.getIndex(center) == static_cast<int>(i));
+    PSTEST_ASSERT(meshMaterials->at(i) == structuredMaterials->at(i));
+
+    const auto &neighbors = meshCellSet.getNeighbors(i);
+    PSTEST_ASSERT(structuredCellSet.getNeighbors(i) == neighbors);
+
+    // in the non-periodic direction, the neighbors are the cells at the
+    // adjacent cell centers
+    for (int side = 0; side < 2; ++side) {
+      auto neighborCenter = center;
+      neighborCenter[D - 1] += side == 0 ? -gridDelta : gridDelta;
+      PSTEST_ASSERT(neighbors[2 * (D - 1) + side] ==
+                    meshCellSet.getIndex(neighborCenter));
+    }
+  }
+}
+
+template <class NumericType, int D> void psRunTest() {
+  using lsDomainType = psSmartPointer<lsDomain<NumericType, D>>;
+  const NumericType gridDelta = 0.1;
+
+  double bounds[2 * D];
+  lsBoundaryConditionEnum<D> boundaryCondition[D];
+  for (int i = 0; i < D; ++i) {
+    bounds[2 * i] = -1.;
+    bounds[2 * i + 1] = 1.;
+    boundaryCondition[i] = lsBoundaryConditionEnum<D>::PERIODIC_BOUNDARY;
+  }
+  boundaryCondition[D - 1] = lsBoundaryConditionEnum<D>::INFINITE_BOUNDARY;
+
+  auto makePlane = [&](const NumericType height) {
+    NumericType origin[D] = {0.};
+    NumericType normal[D] = {0.};
+    origin[D - 1] = height;
+    normal[D - 1] = 1.;
+    auto plane = lsDomainType::New(bounds, boundaryCondition, gridDelta);
+    lsMakeGeometry<NumericType, D>(
+        plane, lsSmartPointer<lsPlane<NumericType, D>>::New(origin, normal))
+        .apply();
+    return plane;
+  };
+
+  // cut a trench down to the given height into the level set
+  auto etchTrench = [&](lsDomainType levelSet, const NumericType bottom) {
+    NumericType minPoint[D];
+    NumericType maxPoint[D];
+    for (int i = 0; i < D - 1; ++i) {
+      minPoint[i] = i == 0 ? -0.35 : -2.;
+      maxPoint[i] = i == 0 ? 0.35 : 2.;
+    }
+    minPoint[D - 1] = bottom;
+    maxPoint[D - 1] = 1.;
+    auto trench = lsDomainType::New(bounds, boundaryCondition, gridDelta);
+    lsMakeGeometry<NumericType, D>(
+        trench, lsSmartPointer<lsBox<NumericType, D>>::New(minPoint, maxPoint))
+        .apply();
+    lsBooleanOperation<NumericType, D>(
+        levelSet, trench, lsBooleanOperationEnum::RELATIVE_COMPLEMENT)
+        .apply();
+  };
+
+  std::array<bool, D> isPeriodic;
+  isPeriodic.fill(true);
+  isPeriodic[D - 1] = false;
+
+  // structured and unstructured cell sets
+  {
+    auto levelSets = psSmartPointer<std::vector<lsDomainType>>::New();
+    levelSets->push_back(makePlane(-0.5));
+    auto substrate = makePlane(0.);
+    etchTrench(substrate, -0.25);
+    levelSets->push_back(substrate);
+
+    auto meshCellSet = psSmartPointer<csDenseCellSet<NumericType, D>>::New();
+    auto structuredCellSet =
+        psSmartPointer<csDenseCellSet<NumericType, D>>::New();
+    structuredCellSet->setStructuredGrid(true);
+    for (auto cellSet : {meshCellSet, structuredCellSet}) {
+      cellSet->setPeriodicBoundary(isPeriodic);
+      cellSet->fromLevelSets(levelSets, nullptr, -1.);
+      cellSet->buildNeighborhood();
+    }
+    PSTEST_ASSERT(!meshCellSet->getStructuredGrid());
+    PSTEST_ASSERT(structuredCellSet->getStructuredGrid());
+    compareCellSets(*meshCellSet, *structuredCellSet);
+
+    // removing cells updates the neighborhood
+    const auto numCells = meshCellSet->getNumberOfCells();
+    etchTrench(substrate, -0.45);
+    for (auto cellSet : {meshCellSet, structuredCellSet})
+      cellSet->updateSurface();
+    PSTEST_ASSERT(meshCellSet->getNumberOfCells() < numCells);
+    compareCellSets(*meshCellSet, *structuredCellSet);
+  }
+
+  // cells added to the surface band receive flux
+  {
+    auto levelSets = psSmartPointer<std::vector<lsDomainType>>::New();
+    levelSets->push_back(makePlane(0.));
+
+    auto cellSet = psSmartPointer<csDenseCellSet<NumericType, D>>::New();
+    cellSet->setStructuredGrid(true);
+    cellSet->setSurfaceBandWidth(0.3);
+    cellSet->setPeriodicBoundary(isPeriodic);
+    cellSet->fromLevelSets(levelSets, nullptr, -2.);
+    const auto initialBottom = cellSet->getBoundingBox()[0][D - 1];
+
+    // etch past the initial band, so that all cells are replaced
+    levelSets->back() = makePlane(-1.);
+    cellSet->updateSurface();
+    PSTEST_ASSERT(cellSet->getNumberOfCells() > 0);
+    PSTEST_ASSERT(cellSet->getBoundingBox()[0][D - 1] < initialBottom - 0.5);
+
+    csTracing<NumericType, D> tracer;
+    auto particle = std::make_unique<FillingParticle<NumericType, D>>();
+    tracer.setParticle(particle);
+    tracer.setNumberOfRaysPerPoint(100);
+    tracer.setCellSet(cellSet);
+    tracer.apply();
+
+    auto fillingFractions = cellSet->getFillingFractions();
+    for (unsigned long i = 0; i < cellSet->getNumberOfCells(); ++i) {
+      PSTEST_ASSERT(cellSet->getCellCenter(i)[D - 1] < initialBottom);
+      PSTEST_ASSERT(fillingFractions->at(i) > 0.);
+    }
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
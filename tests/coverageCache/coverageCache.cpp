@@ -0,0 +1,155 @@
+#include <psCoverageCache.hpp>
+#include <psMakePlane.hpp>
+#include <psProcess.hpp>
+#include <psSF6O2Etching.hpp>
+#include <psTestAssert.hpp>
+
+#include <cstdio>
+#include <optional>
+
+template <class NumericType, int D> void psRunTest() {
+  using cacheType = psCoverageCache<NumericType>;
+  using pointsType = std::vector<std::array<NumericType, 3>>;
+
+  // cache lookup
+  {
+    cacheType cache;
+    typename cacheType::Entry entry;
+    PSTEST_ASSERT(!cache.find(1, 1, entry));
+
+    const pointsType points = {{0., 0., 0.}, {1., 0., 0.}};
+    psPointData<NumericType> coverages;
+    coverages.insertNextScalarData(std::vector<NumericType>{0.1, 0.2}, "c");
+    cache.insert(1, 1, points, coverages);
+    cache.insert(1, 2, points, coverages);
+    cache.insert(2, 1, points, coverages);
+    PSTEST_ASSERT(cache.size() == 3);
+
+    // same geometry and parameters
+    PSTEST_ASSERT(cache.find(1, 1, entry));
+    PSTEST_ASSERT(entry.geometryKey == 1 && entry.parameterKey == 1);
+    PSTEST_ASSERT(entry.points == points);
+    PSTEST_ASSERT(*entry.coverages->getScalarData("c") ==
+                  *coverages.getScalarData("c"));
+
+    // other parameters: most recent entry on the same geometry
+    PSTEST_ASSERT(cache.find(1, 3, entry));
+    PSTEST_ASSERT(entry.geometryKey == 1 && entry.parameterKey == 2);
+
+    // other geometry: no entry
+    PSTEST_ASSERT(!cache.find(3, 1, entry));
+
+    // other geometry with close points: most recent entry with the same
+    // parameters
+    pointsType closePoints = points;
+    closePoints[1][1] += 0.5;
+    PSTEST_ASSERT(cache.find(3, 2, closePoints, 0.5, entry));
+    PSTEST_ASSERT(entry.geometryKey == 1 && entry.parameterKey == 2);
+    PSTEST_ASSERT(cache.find(3, 3, closePoints, 0.5, entry));
+    PSTEST_ASSERT(entry.geometryKey == 2 && entry.parameterKey == 1);
+
+    // other geometry with distant points or another number of points
+    PSTEST_ASSERT(!cache.find(3, 1, closePoints, 0.25, entry));
+    const pointsType otherPoints = {{0., 0., 0.}};
+    PSTEST_ASSERT(!cache.find(3, 1, otherPoints, 0.5, entry));
+
+    // an entry with the same keys is replaced
+    psPointData<NumericType> newCoverages;
+    newCoverages.insertNextScalarData(std::vector<NumericType>{0.3, 0.4}, "c");
+    cache.insert(1, 1, points, newCoverages);
+    PSTEST_ASSERT(cache.size() == 3);
+    PSTEST_ASSERT(cache.find(1, 1, entry));
+    PSTEST_ASSERT(*entry.coverages->getScalarData("c") ==
+                  *newCoverages.getScalarData("c"));
+
+    // save and load
+    const std::string fileName = "coverageCache.bin";
+    cache.save(fileName);
+    cacheType loadedCache;
+    loadedCache.load(fileName);
+    std::remove(fileName.c_str());
+    PSTEST_ASSERT(loadedCache.size() == 3);
+    PSTEST_ASSERT(loadedCache.find(2, 1, entry));
+    PSTEST_ASSERT(entry.geometryKey == 2 && entry.parameterKey == 1);
+    PSTEST_ASSERT(entry.points == points);
+    PSTEST_ASSERT(*entry.coverages->getScalarData("c") ==
+                  *coverages.getScalarData("c"));
+  }
+
+  // geometry keys
+  {
+    const NumericType gridDelta = 0.5;
+    const pointsType points = {{0., 0., 0.}, {0.5, 0., 0.}};
+    const std::vector<NumericType> materialIds = {0., 1.};
+    const auto key = cacheType::hashGeometry(points, materialIds, gridDelta);
+
+    auto closePoints = points;
+    closePoints[1][0] += 1e-6 * gridDelta;
+    PSTEST_ASSERT(cacheType::hashGeometry(closePoints, materialIds,
+                                          gridDelta) == key);
+
+    auto movedPoints = points;
+    movedPoints[1][0] += gridDelta;
+    PSTEST_ASSERT(cacheType::hashGeometry(movedPoints, materialIds,
+                                          gridDelta) != key);
+
+    const std::vector<NumericType> otherMaterialIds = {0., 2.};
+    PSTEST_ASSERT(cacheType::hashGeometry(points, otherMaterialIds,
+                                          gridDelta) != key);
+  }
+
+  // coverage initialization with a cache
+  {
+    auto model = psSmartPointer<psSF6O2Etching<NumericType, D>>::New(
+        12., 1.8e3, 1.0e2, 100., 10.);
+    auto cache = psSmartPointer<cacheType>::New();
+
+    auto runProcess = [&](auto processModel, const NumericType height,
+                          std::optional<std::size_t> parameterKey) {
+      auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+      psMakePlane<NumericType, D>(domain, 1., 10., 10., height, true,
+                                  psMaterial::Si)
+          .apply();
+      psProcess<NumericType, D> process(domain, processModel, 1e-3);
+      process.setMaxCoverageInitIterations(10);
+      if (parameterKey)
+        process.setCoverageCache(cache, *parameterKey);
+      else
+        process.setCoverageCache(cache);
+      process.apply();
+      return process.getCoverageResidualHistory();
+    };
+
+    // the first process adds its coverages to the cache
+    const auto residuals = runProcess(model, 0., 1);
+    PSTEST_ASSERT(!residuals.empty());
+    PSTEST_ASSERT(cache->size() == 1);
+
+    // the same geometry and parameter key skip the initialization
+    PSTEST_ASSERT(runProcess(model, 0., 1).empty());
+    PSTEST_ASSERT(cache->size() == 1);
+
+    // without a key the initialization always runs
+    PSTEST_ASSERT(!runProcess(model, 0., std::nullopt).empty());
+    PSTEST_ASSERT(!runProcess(model, 0., std::nullopt).empty());
+    PSTEST_ASSERT(cache->size() == 2);
+
+    // other model parameters are no exact hit
+    auto otherParameters = psSmartPointer<psSF6O2Etching<NumericType, D>>::New(
+        12., 1.8e3, 2.0e2, 100., 10.);
+    PSTEST_ASSERT(!runProcess(otherParameters, 0., std::nullopt).empty());
+
+    // neither is another model with the same key
+    auto otherModel = psSmartPointer<psSF6O2Etching<NumericType, D>>::New(
+        12., 1.8e3, 1.0e2, 100., 10.);
+    otherModel->setProcessName("OtherModel");
+    PSTEST_ASSERT(!runProcess(otherModel, 0., 1).empty());
+
+    // a close geometry starts from the coverages mapped from the cache
+    const auto seededResiduals = runProcess(model, 0.25, 1);
+    PSTEST_ASSERT(!seededResiduals.empty());
+    PSTEST_ASSERT(seededResiduals.front() < residuals.front());
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
@@ -0,0 +1,43 @@
+#include <psMakePlane.hpp>
+#include <psProcess.hpp>
+#include <psSF6O2Etching.hpp>
+#include <psTestAssert.hpp>
+
+template <class NumericType, int D> void psRunTest() {
+  const unsigned maxIterations = 20;
+
+  // Returns the residuals of the coverage initialization on a plane.
+  auto initializeCoverages = [&](NumericType tolerance,
+                                 psCoverageResidualNorm norm) {
+    auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+    psMakePlane<NumericType, D>(domain, 1., 10., 10., 0., true, psMaterial::Si)
+        .apply();
+    auto model = psSmartPointer<psSF6O2Etching<NumericType, D>>::New(
+        12., 1.8e3, 1.0e2, 100., 10.);
+    psProcess<NumericType, D> process(domain, model, 1e-3);
+    process.setMaxCoverageInitIterations(maxIterations);
+    process.setCoverageConvergenceTolerance(tolerance, norm);
+    process.apply();
+    PSTEST_ASSERT(process.getProfile().coverageInitializationIterations ==
+                  process.getCoverageResidualHistory().size());
+    return process.getCoverageResidualHistory();
+  };
+
+  // without a tolerance, all iterations are run
+  PSTEST_ASSERT(initializeCoverages(0., psCoverageResidualNorm::MAX).size() ==
+                maxIterations);
+
+  // the initialization stops in the first iteration below the tolerance
+  const NumericType tolerance = 0.1;
+  for (const auto norm :
+       {psCoverageResidualNorm::MAX, psCoverageResidualNorm::L2}) {
+    const auto residuals = initializeCoverages(tolerance, norm);
+    PSTEST_ASSERT(!residuals.empty());
+    PSTEST_ASSERT(residuals.size() < maxIterations);
+    PSTEST_ASSERT(residuals.back() < tolerance);
+    for (std::size_t i = 0; i + 1 < residuals.size(); ++i)
+      PSTEST_ASSERT(residuals[i] >= tolerance);
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
@@ -87,5 +87,56 @@ int main() {
     PSTEST_ASSERT(domainCopy->getCellSet().get() != domain->getCellSet().get());
     PSTEST_ASSERT(domainCopy->getMaterialMap().get() !=
                   domain->getMaterialMap().get());
+
+    // deep copy constructor
+    auto constructedCopy = psSmartPointer<psDomain<double, D>>::New(domain);
+    PSTEST_ASSERT(constructedCopy->getLevelSets()->size() == 2);
+    PSTEST_ASSERT(constructedCopy->getLevelSets().get() !=
+                  domain->getLevelSets().get());
+    PSTEST_ASSERT(constructedCopy->getLevelSets()->front().get() !=
+                  domain->getLevelSets()->front().get());
+    PSTEST_ASSERT(constructedCopy->getCellSet());
+    PSTEST_ASSERT(constructedCopy->getCellSet()->getNumberOfCells() ==
+                  domain->getCellSet()->getNumberOfCells());
+
+    // serialization
+    std::stringstream stream;
+    domain->serialize(stream);
+    auto domainRead = psSmartPointer<psDomain<double, D>>::New();
+    domainRead->deserialize(stream);
+    PSTEST_ASSERT(stream);
+    PSTEST_ASSERT(domainRead->getLevelSets()->size() == 2);
+    PSTEST_ASSERT(domainRead->getMaterialMap());
+    PSTEST_ASSERT(domainRead->getMaterialMap()->getMaterialAtIdx(1) ==
+                  psMaterial::SiO2);
+    PSTEST_ASSERT(domainRead->getLevelSets()->back()->getNumberOfPoints() ==
+                  domain->getLevelSets()->back()->getNumberOfPoints());
+
+    // the cell set is restored from the stored cells
+    auto cellSetRead = domainRead->getCellSet();
+    PSTEST_ASSERT(cellSetRead);
+    PSTEST_ASSERT(cellSetRead->getDepth() == 3.);
+    PSTEST_ASSERT(cellSetRead->getCellSetPosition());
+    PSTEST_ASSERT(cellSetRead->getNumberOfCells() ==
+                  domain->getCellSet()->getNumberOfCells());
+    PSTEST_ASSERT(*cellSetRead->getScalarData("Material") ==
+                  *domain->getCellSet()->getScalarData("Material"));
+
+    // also if the domain has a cell set with a different number of cells
+    domainCopy->generateCellSet(1., true);
+    PSTEST_ASSERT(domainCopy->getCellSet()->getNumberOfCells() !=
+                  domain->getCellSet()->getNumberOfCells());
+    std::stringstream copyStream;
+    domain->serialize(copyStream);
+    domainCopy->deserialize(copyStream);
+    PSTEST_ASSERT(copyStream);
+    PSTEST_ASSERT(domainCopy->getCellSet()->getNumberOfCells() ==
+                  domain->getCellSet()->getNumberOfCells());
+
+    // incomplete data fails the deserialization
+    std::stringstream truncatedStream(
+        copyStream.str().substr(0, copyStream.str().size() - 1));
+    domainCopy->deserialize(truncatedStream);
+    PSTEST_ASSERT(!truncatedStream);
   }
 }
\ No newline at end of file
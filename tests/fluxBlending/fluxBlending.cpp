@@ -0,0 +1,85 @@
+#include <geometries/psMakeTrench.hpp>
+#include <psKDTree.hpp>
+#include <psProcess.hpp>
+#include <psSingleParticleProcess.hpp>
+#include <psTestAssert.hpp>
+
+// Surface model recording the fluxes and surface points of every time step.
+template <typename NumericType>
+class RecordingSurfaceModel : public psSurfaceModel<NumericType> {
+public:
+  std::vector<std::vector<NumericType>> fluxes;
+  std::vector<std::vector<std::array<NumericType, 3>>> points;
+
+  psSmartPointer<std::vector<NumericType>> calculateVelocities(
+      psSmartPointer<psPointData<NumericType>> rates,
+      const std::vector<std::array<NumericType, 3>> &coordinates,
+      const std::vector<NumericType> &materialIds) override {
+    auto flux = rates->getScalarData("particleFlux");
+    fluxes.push_back(*flux);
+    points.push_back(coordinates);
+    return psSmartPointer<std::vector<NumericType>>::New(*flux);
+  }
+};
+
+template <class NumericType, int D> void psRunTest() {
+  using surfaceModelType = RecordingSurfaceModel<NumericType>;
+
+  // Runs a deposition in a trench and returns the recorded surface model.
+  auto runProcess = [](NumericType blendingFactor) {
+    auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+    psMakeTrench<NumericType, D>(domain, 0.1, 1., 1., 0.4, 0.5).apply();
+    domain->duplicateTopLevelSet();
+
+    auto surfaceModel = psSmartPointer<surfaceModelType>::New();
+    auto particle = std::make_unique<
+        SingleParticleImplementation::Particle<NumericType, D>>(0.1, 1.);
+    auto model = psSmartPointer<psProcessModel<NumericType, D>>::New();
+    model->setSurfaceModel(surfaceModel);
+    model->setVelocityField(
+        psSmartPointer<psDefaultVelocityField<NumericType>>::New());
+    model->insertNextParticleType(particle);
+
+    psProcess<NumericType, D> process(domain, model, 0.5);
+    process.setNumberOfRaysPerPoint(100);
+    process.setFluxBlendingFactor(blendingFactor);
+    process.apply();
+    PSTEST_ASSERT(surfaceModel->fluxes.size() > 2);
+    PSTEST_ASSERT(surfaceModel->fluxes.size() ==
+                  process.getProfile().steps.size());
+    return surfaceModel;
+  };
+
+  // Returns true if the fluxes of the step equal the fluxes of the previous
+  // step at the nearest surface point.
+  auto equalsPreviousStep = [](const surfaceModelType &surfaceModel,
+                               std::size_t step) {
+    psKDTree<NumericType, std::array<NumericType, 3>> kdTree(
+        surfaceModel.points[step - 1]);
+    kdTree.build();
+    const auto &points = surfaceModel.points[step];
+    for (std::size_t j = 0; j < points.size(); ++j) {
+      const auto nearest = kdTree.findNearest(points[j])->first;
+      if (surfaceModel.fluxes[step][j] !=
+          surfaceModel.fluxes[step - 1][nearest])
+        return false;
+    }
+    return true;
+  };
+
+  // with a weight of 0, the previous rates are kept
+  {
+    auto surfaceModel = runProcess(0.);
+    for (std::size_t i = 1; i < surfaceModel->fluxes.size(); ++i)
+      PSTEST_ASSERT(equalsPreviousStep(*surfaceModel, i));
+  }
+
+  // with a weight of 1, the traced rates are used
+  {
+    auto surfaceModel = runProcess(1.);
+    for (std::size_t i = 1; i < surfaceModel->fluxes.size(); ++i)
+      PSTEST_ASSERT(!equalsPreviousStep(*surfaceModel, i));
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
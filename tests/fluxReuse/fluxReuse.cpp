@@ -0,0 +1,95 @@
+#include <geometries/psMakeTrench.hpp>
+#include <psKDTree.hpp>
+#include <psProcess.hpp>
+#include <psSingleParticleProcess.hpp>
+#include <psTestAssert.hpp>
+
+// Surface model recording the fluxes and surface points of every time step.
+template <typename NumericType>
+class RecordingSurfaceModel : public psSurfaceModel<NumericType> {
+public:
+  std::vector<std::vector<NumericType>> fluxes;
+  std::vector<std::vector<std::array<NumericType, 3>>> points;
+
+  psSmartPointer<std::vector<NumericType>> calculateVelocities(
+      psSmartPointer<psPointData<NumericType>> rates,
+      const std::vector<std::array<NumericType, 3>> &coordinates,
+      const std::vector<NumericType> &materialIds) override {
+    auto flux = rates->getScalarData("particleFlux");
+    fluxes.push_back(*flux);
+    points.push_back(coordinates);
+    return psSmartPointer<std::vector<NumericType>>::New(*flux);
+  }
+};
+
+template <class NumericType, int D> void psRunTest() {
+  using surfaceModelType = RecordingSurfaceModel<NumericType>;
+
+  // Runs a deposition in a trench and returns the recorded surface model.
+  auto runProcess = [](unsigned fluxUpdateInterval,
+                       psProcessProfile &profile) {
+    auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+    psMakeTrench<NumericType, D>(domain, 0.1, 1., 1., 0.4, 0.5).apply();
+    domain->duplicateTopLevelSet();
+
+    auto surfaceModel = psSmartPointer<surfaceModelType>::New();
+    auto particle = std::make_unique<
+        SingleParticleImplementation::Particle<NumericType, D>>(0.1, 1.);
+    auto model = psSmartPointer<psProcessModel<NumericType, D>>::New();
+    model->setSurfaceModel(surfaceModel);
+    model->setVelocityField(
+        psSmartPointer<psDefaultVelocityField<NumericType>>::New());
+    model->insertNextParticleType(particle);
+
+    psProcess<NumericType, D> process(domain, model, 0.5);
+    process.setNumberOfRaysPerPoint(100);
+    process.setFluxUpdateInterval(fluxUpdateInterval);
+    process.apply();
+    profile = process.getProfile();
+    return surfaceModel;
+  };
+
+  // with an interval of 1, the fluxes are traced in every step
+  {
+    psProcessProfile profile;
+    auto surfaceModel = runProcess(1, profile);
+    PSTEST_ASSERT(profile.steps.size() > 3);
+    PSTEST_ASSERT(surfaceModel->fluxes.size() == profile.steps.size());
+    for (std::size_t i = 0; i < profile.steps.size(); ++i) {
+      PSTEST_ASSERT(profile.steps[i].fluxesTraced);
+      if (i > 0)
+        PSTEST_ASSERT(surfaceModel->fluxes[i] != surfaceModel->fluxes[i - 1]);
+    }
+  }
+
+  // reused fluxes are the traced fluxes at the nearest surface point
+  {
+    const unsigned interval = 3;
+    psProcessProfile profile;
+    auto surfaceModel = runProcess(interval, profile);
+    PSTEST_ASSERT(profile.steps.size() > interval);
+    PSTEST_ASSERT(surfaceModel->fluxes.size() == profile.steps.size());
+
+    std::size_t tracedStep = 0;
+    for (std::size_t i = 0; i < profile.steps.size(); ++i) {
+      PSTEST_ASSERT(profile.steps[i].fluxesTraced == (i % interval == 0));
+      if (profile.steps[i].fluxesTraced) {
+        tracedStep = i;
+        continue;
+      }
+
+      psKDTree<NumericType, std::array<NumericType, 3>> kdTree(
+          surfaceModel->points[tracedStep]);
+      kdTree.build();
+      const auto &tracedFlux = surfaceModel->fluxes[tracedStep];
+      const auto &points = surfaceModel->points[i];
+      PSTEST_ASSERT(surfaceModel->fluxes[i].size() == points.size());
+      for (std::size_t j = 0; j < points.size(); ++j) {
+        const auto nearest = kdTree.findNearest(points[j])->first;
+        PSTEST_ASSERT(surfaceModel->fluxes[i][j] == tracedFlux[nearest]);
+      }
+    }
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
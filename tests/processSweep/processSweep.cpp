@@ -0,0 +1,95 @@
+#include <psIsotropicProcess.hpp>
+#include <psMakePlane.hpp>
+#include <psProcessSweep.hpp>
+#include <psSF6O2Etching.hpp>
+#include <psTestAssert.hpp>
+
+#include <lsToDiskMesh.hpp>
+
+// Mean height of the surface of the top level set.
+template <class NumericType, int D>
+NumericType surfaceHeight(psSmartPointer<psDomain<NumericType, D>> domain) {
+  auto mesh = psSmartPointer<lsMesh<NumericType>>::New();
+  lsToDiskMesh<NumericType, D> meshConverter(mesh);
+  meshConverter.insertNextLevelSet(domain->getLevelSets()->back());
+  meshConverter.apply();
+  NumericType height = 0.;
+  for (const auto &node : mesh->getNodes())
+    height += node[D - 1];
+  return height / mesh->getNodes().size();
+}
+
+template <class NumericType, int D> void psRunTest() {
+  using sweepType = psProcessSweep<NumericType, D>;
+
+  auto domain = psSmartPointer<psDomain<NumericType, D>>::New();
+  psMakePlane<NumericType, D>(domain, 1., 10., 10., 0., true, psMaterial::Si)
+      .apply();
+
+  // the variants run on copies of the initial domain
+  {
+    sweepType sweep(domain);
+    sweep.insertNextVariant(
+        psSmartPointer<psIsotropicProcess<NumericType, D>>::New(-1.), 2.);
+    sweep.insertNextVariant(
+        psSmartPointer<psIsotropicProcess<NumericType, D>>::New(-2.), 2.);
+    sweep.apply();
+
+    const auto &results = sweep.getResults();
+    PSTEST_ASSERT(results.size() == 2);
+    PSTEST_ASSERT(sweep.getProfiles().size() == 2);
+    for (const auto &result : results) {
+      PSTEST_ASSERT(result && result != domain);
+      PSTEST_ASSERT(result->getLevelSets()->size() == 1);
+      PSTEST_ASSERT(result->getLevelSets()->back() !=
+                    domain->getLevelSets()->back());
+    }
+    PSTEST_ASSERT(std::abs(surfaceHeight(domain)) < 0.1);
+    PSTEST_ASSERT(std::abs(surfaceHeight(results[0]) + 2.) < 0.5);
+    PSTEST_ASSERT(std::abs(surfaceHeight(results[1]) + 4.) < 0.5);
+  }
+
+  // coverage cache keys
+  {
+    auto makeModel = [] {
+      return psSmartPointer<psSF6O2Etching<NumericType, D>>::New(
+          12., 1.8e3, 1.0e2, 100., 10.);
+    };
+    auto setup = [](psProcess<NumericType, D> &process, std::size_t) {
+      process.setMaxCoverageInitIterations(10);
+    };
+
+    sweepType sweep(domain);
+    sweep.setProcessSetup(setup);
+    sweep.insertNextVariant(makeModel(), 1e-3, 1);
+    sweep.apply();
+    PSTEST_ASSERT(sweep.getProfiles()[0].coverageInitializationIterations > 0);
+    PSTEST_ASSERT(sweep.getCoverageCache()->size() == 1);
+
+    // a variant with the same key skips the initialization, a variant without
+    // a key is only seeded from the cache
+    sweepType nextSweep(domain);
+    nextSweep.setProcessSetup(setup);
+    nextSweep.setCoverageCache(sweep.getCoverageCache());
+    nextSweep.insertNextVariant(makeModel(), 1e-3, 1);
+    nextSweep.insertNextVariant(makeModel(), 1e-3);
+    nextSweep.apply();
+    const auto &profiles = nextSweep.getProfiles();
+    PSTEST_ASSERT(profiles[0].coverageInitializationIterations == 0);
+    PSTEST_ASSERT(profiles[1].coverageInitializationIterations > 0);
+    PSTEST_ASSERT(sweep.getCoverageCache()->size() == 2);
+
+    // variants without a key replace their cache entry
+    sweepType unkeyedSweep(domain);
+    unkeyedSweep.setProcessSetup(setup);
+    unkeyedSweep.setCoverageCache(sweep.getCoverageCache());
+    unkeyedSweep.insertNextVariant(makeModel(), 1e-3);
+    unkeyedSweep.insertNextVariant(makeModel(), 1e-3);
+    unkeyedSweep.apply();
+    for (const auto &profile : unkeyedSweep.getProfiles())
+      PSTEST_ASSERT(profile.coverageInitializationIterations > 0);
+    PSTEST_ASSERT(sweep.getCoverageCache()->size() == 2);
+  }
+}
+
+int main() { PSRUN_ALL_TESTS }
@@ -0,0 +1,79 @@
+#include <psTestAssert.hpp>
+#include <psTranslationField.hpp>
+
+// Velocity field which also depends on the coordinate.
+template <class NumericType>
+class CoordinateVelocityField : public psDefaultVelocityField<NumericType> {
+public:
+  NumericType getScalarVelocity(const std::array<NumericType, 3> &coordinate,
+                                int material,
+                                const std::array<NumericType, 3> &normalVector,
+                                unsigned long pointId) override {
+    return coordinate[0] *
+           psDefaultVelocityField<NumericType>::getScalarVelocity(
+               coordinate, material, normalVector, pointId);
+  }
+};
+
+template <class NumericType> void psRunTest() {
+  using fieldType = psTranslationField<NumericType>;
+  using denseTranslatorType = typename fieldType::denseTranslatorType;
+  constexpr auto unmappedId = fieldType::unmappedId;
+
+  // level set points without a surface point are unmapped
+  typename fieldType::translatorType translator = {{0, 5}, {3, 7}};
+  auto denseTranslator = psSmartPointer<denseTranslatorType>::New();
+  fieldType::toDenseTranslator(translator, 5, *denseTranslator);
+  const denseTranslatorType expected = {5, unmappedId, unmappedId, 7,
+                                        unmappedId};
+  PSTEST_ASSERT(*denseTranslator == expected);
+
+  // ids beyond the number of level set points extend the dense translator
+  translator[8] = 2;
+  fieldType::toDenseTranslator(translator, 5, *denseTranslator);
+  PSTEST_ASSERT(denseTranslator->size() == 9);
+  PSTEST_ASSERT(denseTranslator->at(8) == 2);
+  for (std::size_t i : {1, 2, 4, 5, 6, 7})
+    PSTEST_ASSERT(denseTranslator->at(i) == unmappedId);
+
+  // the previous content of the reused storage is cleared
+  fieldType::toDenseTranslator({{1, 4}}, 3, *denseTranslator);
+  PSTEST_ASSERT(*denseTranslator ==
+                denseTranslatorType({unmappedId, 4, unmappedId}));
+
+  // velocities are looked up at the translated surface point
+  auto velocities = psSmartPointer<std::vector<NumericType>>::New(
+      std::vector<NumericType>{0., 1., 2., 3., 4., 5., 6., 7.});
+  auto velocityField =
+      psSmartPointer<psDefaultVelocityField<NumericType>>::New();
+  velocityField->setVelocities(velocities);
+  fieldType translationField(
+      std::dynamic_pointer_cast<psVelocityField<NumericType>>(velocityField),
+      nullptr);
+  fieldType::toDenseTranslator(translator, 5, *denseTranslator);
+  translationField.setTranslator(denseTranslator);
+
+  const std::array<NumericType, 3> coordinate = {0., 0., 0.};
+  PSTEST_ASSERT(translationField.getScalarVelocity(coordinate, 0, coordinate,
+                                                   3) == 7.);
+  PSTEST_ASSERT(translationField.getScalarVelocity(coordinate, 0, coordinate,
+                                                   8) == 2.);
+
+  // unmapped ids are passed on unchanged
+  unsigned long lsId = 4;
+  translationField.translateLsId(lsId, coordinate);
+  PSTEST_ASSERT(lsId == 4);
+  lsId = 100;
+  translationField.translateLsId(lsId, coordinate);
+  PSTEST_ASSERT(lsId == 100);
+
+  // only the default velocity field itself depends on the point id alone
+  PSTEST_ASSERT(velocityField->useOnlyPointId());
+  PSTEST_ASSERT(!psSmartPointer<CoordinateVelocityField<NumericType>>::New()
+                     ->useOnlyPointId());
+}
+
+int main() {
+  psRunTest<double>();
+  psRunTest<float>();
+}